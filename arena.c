@@ -0,0 +1,89 @@
+#include "arena.h"
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+/* memory is committed in steps of this many bytes, also the huge page
+ * size on x86-64 */
+#define ARENA_COMMIT (2 << 20)
+
+int arena_init(arena_t *self, size_t reserve, int huge_pages)
+{
+	reserve = (reserve + ARENA_COMMIT - 1) & ~((size_t)ARENA_COMMIT - 1);
+	self->committed = 0;
+	self->top = 0;
+	self->huge_pages = huge_pages;
+#ifdef WIN32
+	self->base = VirtualAlloc(NULL, reserve, MEM_RESERVE, PAGE_NOACCESS);
+#else
+	self->base = mmap(NULL, reserve, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(self->base == MAP_FAILED) self->base = NULL;
+#endif
+	self->reserved = self->base ? reserve : 0;
+	return self->base != NULL;
+}
+
+static int arena_commit(arena_t *self, size_t size)
+{
+	char *start = self->base + self->committed;
+	size = (size + ARENA_COMMIT - 1) & ~((size_t)ARENA_COMMIT - 1);
+	if(size > self->reserved - self->committed) return 0;
+#ifdef WIN32
+	if(!VirtualAlloc(start, size, MEM_COMMIT, PAGE_READWRITE)) return 0;
+#else
+	if(mprotect(start, size, PROT_READ | PROT_WRITE)) return 0;
+#ifdef MADV_HUGEPAGE
+	if(self->huge_pages) madvise(start, size, MADV_HUGEPAGE);
+#endif
+#endif
+	self->committed += size;
+	return 1;
+}
+
+void *arena_push(arena_t *self, size_t size)
+{
+	if(!self->base) return NULL;
+	if(size > self->reserved - self->top) return NULL;
+	if(self->top + size > self->committed &&
+			!arena_commit(self, self->top + size - self->committed))
+	{
+		return NULL;
+	}
+	void *block = self->base + self->top;
+	self->top += size;
+	return block;
+}
+
+void arena_pop(arena_t *self, void *block)
+{
+	self->top = (char*)block - self->base;
+}
+
+void arena_reset(arena_t *self)
+{
+	if(!self->base) return;
+#ifdef WIN32
+	VirtualFree(self->base, self->committed, MEM_DECOMMIT);
+#else
+	mprotect(self->base, self->committed, PROT_NONE);
+	madvise(self->base, self->committed, MADV_DONTNEED);
+#endif
+	self->committed = 0;
+	self->top = 0;
+}
+
+void arena_release(arena_t *self)
+{
+	if(!self->base) return;
+#ifdef WIN32
+	VirtualFree(self->base, 0, MEM_RELEASE);
+#else
+	munmap(self->base, self->reserved);
+#endif
+	self->base = NULL;
+	self->reserved = self->committed = self->top = 0;
+}
@@ -0,0 +1,34 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* Stack allocator over one reserved range of address space. The range is
+ * only committed as the top grows, so reservations can be generous, and
+ * blocks are released in reverse order of allocation. */
+typedef struct
+{
+	char *base;
+	size_t reserved;
+	size_t committed;
+	size_t top;
+	int huge_pages;
+} arena_t;
+
+/* returns 0 if the range can't be reserved */
+int arena_init(arena_t *self, size_t reserve, int huge_pages);
+/* NULL once the reservation is exhausted */
+void *arena_push(arena_t *self, size_t size);
+/* block must be the last one pushed */
+void arena_pop(arena_t *self, void *block);
+/* drops every block and hands the memory back to the system */
+void arena_reset(arena_t *self);
+void arena_release(arena_t *self);
+
+static inline int arena_owns(const arena_t *self, const void *ptr)
+{
+	return self->base && (const char*)ptr >= self->base &&
+		(const char*)ptr < self->base + self->reserved;
+}
+
+#endif /* !ARENA_H */
@@ -26,24 +26,85 @@ void candle_reset_dir(candle_t *self)
 #endif
 }
 
-int handle_event(candle_t *self, SDL_Event event)
+/* Events travel through two single producer, single consumer rings. The
+ * input thread owns the window, pumps SDL's queue and pushes everything
+ * into g_events without blocking on a frame. The render thread drains it,
+ * lets the UI and window handling see each event first, and forwards the
+ * rest into g_input, which the ticker drains at the start of every tick. */
+#define INPUT_RING_SIZE 1024 /* power of two */
+
+typedef struct
 {
-	char key;
-	if(self->mouse_owners[0] != entity_null)
+	SDL_Event events[INPUT_RING_SIZE];
+	SDL_atomic_t head; /* written by the producer */
+	SDL_atomic_t tail; /* written by the consumer */
+} input_ring_t;
+
+static input_ring_t g_events; /* input thread to render thread */
+static input_ring_t g_input; /* render thread to ticker */
+/* motion not yet pushed, consecutive motion events are merged into it */
+static SDL_Event g_motion;
+static int g_motion_pending = 0;
+
+static int input_space(input_ring_t *ring)
+{
+	return INPUT_RING_SIZE - (SDL_AtomicGet(&ring->head) -
+			SDL_AtomicGet(&ring->tail));
+}
+
+static void input_push(input_ring_t *ring, const SDL_Event *event)
+{
+	int head = SDL_AtomicGet(&ring->head);
+	ring->events[head & (INPUT_RING_SIZE - 1)] = *event;
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&ring->head, head + 1);
+}
+
+static int input_pop(input_ring_t *ring, SDL_Event *event)
+{
+	int tail = SDL_AtomicGet(&ring->tail);
+	if(tail == SDL_AtomicGet(&ring->head)) return 0;
+	SDL_MemoryBarrierAcquire();
+	*event = ring->events[tail & (INPUT_RING_SIZE - 1)];
+	SDL_AtomicSet(&ring->tail, tail + 1);
+	return 1;
+}
+
+static void input_flush_motion(void)
+{
+	if(!g_motion_pending || !input_space(&g_input)) return;
+	input_push(&g_input, &g_motion);
+	g_motion_pending = 0;
+}
+
+static void input_queue(const SDL_Event *event)
+{
+	if(event->type == SDL_MOUSEMOTION)
 	{
-		if(entity_signal_same(self->mouse_owners[0],
-					event_handle, &event) == 0)
+		if(g_motion_pending)
 		{
-			return 1;
+			g_motion.motion.xrel += event->motion.xrel;
+			g_motion.motion.yrel += event->motion.yrel;
+			g_motion.motion.x = event->motion.x;
+			g_motion.motion.y = event->motion.y;
+			g_motion.motion.state = event->motion.state;
 		}
-	}
-	else
-	{
-		if(entity_signal(entity_null, event_handle, &event) == 0)
+		else
 		{
-			return 1;
+			g_motion = *event;
+			g_motion_pending = 1;
 		}
+		return;
 	}
+	/* keep the order motion and other events were raised in */
+	input_flush_motion();
+	input_push(&g_input, event);
+}
+
+/* runs on the ticker */
+static void handle_input(candle_t *self, SDL_Event event)
+{
+	char key;
 	mouse_button_data bdata;
 	mouse_move_data mdata;
 	switch(event.type)
@@ -103,6 +164,43 @@ int handle_event(candle_t *self, SDL_Event event)
 			}
 			entity_signal(entity_null, key_down, &key);
 			break;
+	}
+}
+
+static void candle_consume_input(candle_t *self)
+{
+	SDL_Event event;
+	while(input_pop(&g_input, &event))
+	{
+		handle_input(self, event);
+	}
+}
+
+/* runs on the render thread, window events and the UI stay here, the
+ * rest is queued for the ticker */
+int handle_event(candle_t *self, SDL_Event event)
+{
+	entity_t owner;
+	SDL_AtomicLock(&self->mouse_lock);
+	owner = self->mouse_owners[0];
+	SDL_AtomicUnlock(&self->mouse_lock);
+
+	if(owner != entity_null)
+	{
+		if(entity_signal_same(owner, event_handle, &event) == 0)
+		{
+			return 1;
+		}
+	}
+	else
+	{
+		if(entity_signal(entity_null, event_handle, &event) == 0)
+		{
+			return 1;
+		}
+	}
+	switch(event.type)
+	{
 		case SDL_WINDOWEVENT:
 			switch(event.window.event)
 			{
@@ -111,41 +209,94 @@ int handle_event(candle_t *self, SDL_Event event)
 					break; 
 			}
 			break;
+		default:
+			input_queue(&event);
+			break;
 	}
 	/* break; */
 
 	return 0;
 }
+
+/* applies the cursor state left by candle_grab_mouse and
+ * candle_release_mouse, SDL wants this done from the window thread, which
+ * is the input thread */
+static void candle_apply_mouse(candle_t *self)
+{
+	int dirty, warp, vis, x, y;
+
+	SDL_AtomicLock(&self->mouse_lock);
+	dirty = self->mouse_dirty;
+	warp = self->mouse_warp;
+	vis = self->mouse_visible[0];
+	x = self->mo_x;
+	y = self->mo_y;
+	self->mouse_dirty = self->mouse_warp = 0;
+	SDL_AtomicUnlock(&self->mouse_lock);
+
+	if(!dirty || self->headless) return;
+
+	if(warp)
+	{
+		SDL_SetRelativeMouseMode(SDL_FALSE);
+		SDL_WarpMouseInWindow(c_window(&self->systems)->window, x, y);
+	}
+	SDL_ShowCursor(vis); 
+	SDL_SetRelativeMouseMode(!vis);
+}
+
+/* runs on the render thread, drains what the input thread pumped */
 static void candle_handle_events(candle_t *self)
 {
 	SDL_Event event;
-	/* SDL_WaitEvent(&event); */
-	/* keySpec(state->key_state, state); */
-	int has_events = 0;
 	entity_signal(entity_null, events_begin, NULL);
-	while(SDL_PollEvent(&event))
+	/* one slot is kept for the pending motion, whatever doesn't fit waits
+	 * in g_events for the next frame */
+	while(input_space(&g_input) > 1 && input_pop(&g_events, &event))
 	{
-		/* if(!) */
-		{
-			/* has_events = 1; */
-			if(event.type == SDL_QUIT)
-			{
-				//close(candle->events[0]);
-				//close(candle->events[1]);
-				self->exit = 1;
-				return;
-			}
-			/* int res = write(candle->events[1], &event, sizeof(event)); */
-			/* if(res == -1) exit(1); */
-			handle_event(self, event);
-		}
+		handle_event(self, event);
 	}
+	input_flush_motion();
 	entity_signal(entity_null, events_end, NULL);
-	if(has_events)
+}
+
+/* Owns the window: creates it, pumps SDL's queue and applies cursor and
+ * fullscreen changes. It never waits on a frame, so a slow frame doesn't
+ * hold events back in SDL. */
+static int input_loop(candle_t *self)
+{
+	SDL_Event event;
+	c_window_t *window;
+
+	self->input_id = SDL_ThreadID();
+	entity_add_component(self->systems, c_window_new(0, 0));
+	window = c_window(&self->systems);
+	SDL_SemPost(self->window_sem);
+
+	while(!self->exit)
 	{
-		/* event.type = SDL_USEREVENT; */
-		/* write(candle->events[1], &event, sizeof(event)); */
+		candle_apply_mouse(self);
+		if(c_window_apply_fullscreen(window, &event) && input_space(&g_events))
+		{
+			input_push(&g_events, &event);
+		}
+
+		/* a full ring leaves events in SDL's queue until the render
+		 * thread catches up */
+		if(!input_space(&g_events))
+		{
+			SDL_Delay(1);
+			continue;
+		}
+		if(!SDL_WaitEventTimeout(&event, 4)) continue;
+		if(event.type == SDL_QUIT)
+		{
+			self->exit = 1;
+			break;
+		}
+		input_push(&g_events, &event);
 	}
+	return 1;
 }
 
 static int render_loop(candle_t *self)
@@ -155,16 +306,19 @@ static int render_loop(candle_t *self)
 	int last = SDL_GetTicks();
 	int fps = 0;
 	self->render_id = SDL_ThreadID();
-	//SDL_GL_MakeCurrent(state->renderer->window, state->renderer->context); 
-	/* SDL_LockMutex(self->mut); */
-	entity_add_component(self->systems, c_window_new(0, 0));
-	/* printf("unlock 2\n"); */
+
+	/* the window lives on the input thread, only its context comes here */
+	self->input_thr = SDL_CreateThread((int(*)(void*))input_loop,
+			"input_loop", self);
+	SDL_SemWait(self->window_sem);
+	c_window_make_current(c_window(&self->systems));
 	SDL_SemPost(self->sem);
 
 	while(!self->exit)
 	{
 		candle_handle_events(self);
 		loader_update(self->loader);
+		c_node_acquire();
 
 		/* if(state->gameStarted) */
 		{
@@ -196,44 +350,85 @@ static int render_loop(candle_t *self)
 void candle_register()
 {
 	signal_init(&world_update, sizeof(float));
+	signal_set_accumulate(world_update, 1);
 	signal_init(&world_draw, sizeof(void*));
 	signal_init(&event_handle, sizeof(void*));
 	signal_init(&events_end, sizeof(void*));
 	signal_init(&events_begin, sizeof(void*));
 }
 
+static void candle_tick(candle_t *self)
+{
+	float dt = self->step;
+	candle_consume_input(self);
+	entity_signal_parallel(entity_null, world_update, &dt);
+	commands_flush();
+	signals_flush();
+	/* nobody reads the transforms back without a render thread */
+	if(self->headless) return;
+	/* no interpolation while fast forwarding, frames go by too fast */
+	c_node_publish(self->fast_forward ? 0.0f : self->step);
+}
+
 static int ticker_loop(candle_t *self)
 {
+	double freq = SDL_GetPerformanceFrequency();
+	self->last_update = SDL_GetPerformanceCounter();
 	do
 	{
-		int current = SDL_GetTicks();
-		float dt = (current - self->last_update) / 1000.0;
-		entity_signal(entity_null, world_update, &dt);
+		Uint64 current = SDL_GetPerformanceCounter();
+		int steps;
+
+		if(self->fast_forward)
+		{
+			candle_tick(self);
+			self->accumulator = 0.0;
+			self->last_update = current;
+			continue;
+		}
+
+		self->accumulator += (current - self->last_update) / freq;
 		self->last_update = current;
-		SDL_Delay(16);
+
+		for(steps = 0; self->accumulator >= self->step &&
+				steps < self->max_steps; steps++)
+		{
+			candle_tick(self);
+			self->accumulator -= self->step;
+		}
+		/* too far behind to catch up, drop the backlog instead of
+		 * spiraling */
+		if(self->accumulator >= self->step)
+		{
+			self->accumulator = fmod(self->accumulator, self->step);
+		}
+
+		double remaining = self->step - self->accumulator;
+		if(remaining > 0.001) SDL_Delay((Uint32)(remaining * 1000.0));
 	}
 	while(!self->exit);
 	return 1;
 }
 
-/* static int candle_loop(candle_t *self) */
-/* { */
-/* 	SDL_Event event; */
+void candle_set_timestep(candle_t *self, float step, int max_steps)
+{
+	self->step = step;
+	self->max_steps = max_steps > 0 ? max_steps : 1;
+}
 
-/* 	ssize_t s; */
-/* 	while((s = read(candle->events[0], &event, sizeof(event))) > 0) */
-/* 	{ */
-/* 		/1* if(event.type == SDL_USEREVENT) break; *1/ */
-/* 		handle_event(self, event); */
-/* 	} */
-/* 	return 1; */
-/* } */
+void candle_fast_forward(candle_t *self, int enabled)
+{
+	self->fast_forward = enabled;
+}
 
 void candle_wait(candle_t *candle)
 {
-	/* SDL_WaitThread(candle->candle_thr, NULL); */
-	SDL_WaitThread(candle->render_thr, NULL);
+	if(candle->render_thr) SDL_WaitThread(candle->render_thr, NULL);
+	if(candle->input_thr) SDL_WaitThread(candle->input_thr, NULL);
 	SDL_WaitThread(candle->ticker_thr, NULL);
+#ifdef ECM_STATS
+	ecm_stats_dump("ecm_stats.csv");
+#endif
 }
 
 void candle_register_template(candle_t *self, const char *key,
@@ -301,17 +496,13 @@ int candle_import_dir(candle_t *self, entity_t root, const char *dir_name)
 void candle_release_mouse(candle_t *self, entity_t ent, int reset)
 {
 	int i;
+	SDL_AtomicLock(&self->mouse_lock);
 	for(i = 0; i < 16; i++)
 	{
 		if(self->mouse_owners[i] == ent)
 		{
 			/* // SDL_SetWindowGrab(mainWindow, SDL_FALSE); */
-			SDL_SetRelativeMouseMode(SDL_FALSE);
-			if(reset)
-			{
-				SDL_WarpMouseInWindow(c_window(&self->systems)->window, self->mo_x,
-						self->mo_y);
-			}
+			if(reset) self->mouse_warp = 1;
 			for(; i < 15; i++)
 			{
 				self->mouse_owners[i] = self->mouse_owners[i + 1];
@@ -320,14 +511,16 @@ void candle_release_mouse(candle_t *self, entity_t ent, int reset)
 			}
 		}
 	}
-	int vis = self->mouse_visible[0];
-	SDL_ShowCursor(vis); 
-	SDL_SetRelativeMouseMode(!vis);
+	self->mouse_dirty = 1;
+	SDL_AtomicUnlock(&self->mouse_lock);
+
+	if(SDL_ThreadID() == self->input_id) candle_apply_mouse(self);
 }
 
 void candle_grab_mouse(candle_t *self, entity_t ent, int visibility)
 {
 	int i;
+	SDL_AtomicLock(&self->mouse_lock);
 	for(i = 15; i >= 1; i--)
 	{
 		self->mouse_owners[i] = self->mouse_owners[i - 1];
@@ -337,21 +530,31 @@ void candle_grab_mouse(candle_t *self, entity_t ent, int visibility)
 	self->mouse_visible[0] = visibility;
 	self->mo_x = self->mx;
 	self->mo_y = self->my;
-	SDL_ShowCursor(visibility); 
-	SDL_SetRelativeMouseMode(!visibility);
+	self->mouse_dirty = 1;
+	SDL_AtomicUnlock(&self->mouse_lock);
+
+	if(SDL_ThreadID() == self->input_id) candle_apply_mouse(self);
 }
 
-candle_t *candle_new(int comps_size, ...)
+static void candle_init(candle_t *self, int comps_size, va_list comps)
 {
-	candle_t *self = calloc(1, sizeof *self);
 	candle = self;
+	candle_set_timestep(self, 1.0f / 60.0f, 5);
 
 	ecm_init();
 
 	self->firstDir = SDL_GetBasePath();
 	candle_reset_dir(self);
 
-	shaders_reg();
+	if(self->headless)
+	{
+		/* no window to bring up the subsystems for us */
+		SDL_Init(SDL_INIT_TIMER|SDL_INIT_EVENTS);
+	}
+	else
+	{
+		shaders_reg();
+	}
 
 
 	int i;
@@ -387,17 +590,18 @@ candle_t *candle_new(int comps_size, ...)
 		c_camera_register();
 		c_sauces_register();
 
-		va_list comps;
-		va_start(comps, comps_size);
+		va_list cbs;
+		va_copy(cbs, comps);
 		int i;
 		for(i = 0; i < comps_size; i++)
 		{
-			c_reg_cb cb = va_arg(comps, c_reg_cb);
+			c_reg_cb cb = va_arg(cbs, c_reg_cb);
 			cb();
 		}
-		va_end(comps);
+		va_end(cbs);
 	}
-	/* ecm_generate_hashes(); */
+	ecm_generate_dispatch();
+	jobs_init(-1);
 
 
 	self->mouse_owners[0] = entity_null;
@@ -405,17 +609,40 @@ candle_t *candle_new(int comps_size, ...)
 
 	self->systems = entity_new(c_physics_new(), c_sauces_new());
 
-	//int res = pipe(self->events);
-	//if(res == -1) exit(1);
-
-	/* self->candle_thr = SDL_CreateThread((int(*)(void*))candle_loop, "candle_loop", candle); */
-	self->sem = SDL_CreateSemaphore(0);
-	self->render_thr = SDL_CreateThread((int(*)(void*))render_loop, "render_loop", candle);
+	if(!self->headless)
+	{
+		self->sem = SDL_CreateSemaphore(0);
+		self->window_sem = SDL_CreateSemaphore(0);
+		self->render_thr = SDL_CreateThread((int(*)(void*))render_loop, "render_loop", candle);
+	}
 	self->ticker_thr = SDL_CreateThread((int(*)(void*))ticker_loop, "ticker_loop", candle);
-	SDL_SemWait(self->sem);
+	if(!self->headless) SDL_SemWait(self->sem);
 	/* SDL_Delay(500); */
 
 	/* candle_import_dir(self, entity_null, "./"); */
+}
+
+candle_t *candle_new(int comps_size, ...)
+{
+	candle_t *self = calloc(1, sizeof *self);
+
+	va_list comps;
+	va_start(comps, comps_size);
+	candle_init(self, comps_size, comps);
+	va_end(comps);
+
+	return self;
+}
+
+candle_t *candle_new_headless(int comps_size, ...)
+{
+	candle_t *self = calloc(1, sizeof *self);
+	self->headless = 1;
+
+	va_list comps;
+	va_start(comps, comps_size);
+	candle_init(self, comps_size, comps);
+	va_end(comps);
 
 	return self;
 }
@@ -26,6 +26,8 @@
 #include <systems/sauces.h>
 
 #include <loader.h>
+#include <jobs.h>
+#include <commands.h>
 
 #include <texture.h>
 
@@ -54,12 +56,17 @@ typedef struct candle_t
 	entity_t systems;
 	loader_t *loader;
 
-	int events[2];
-
 	char *firstDir;
 
 	int exit;
-	int last_update;
+	int headless; /* no window, GL context or render thread */
+
+	/* fixed timestep, every world_update advances by step seconds */
+	Uint64 last_update;
+	double accumulator;
+	float step;
+	int max_steps; /* ticks run per wake up when catching up */
+	int fast_forward; /* tick back to back, ignoring real time */
 	int pressing;
 	int shift;
 
@@ -68,22 +75,32 @@ typedef struct candle_t
 	entity_t mouse_owners[16];
 	int mouse_visible[16];
 	int mo_x, mo_y;
+	/* grabs and releases come from input handlers on the ticker, the
+	 * cursor itself is only touched by the window thread */
+	SDL_SpinLock mouse_lock;
+	int mouse_dirty;
+	int mouse_warp;
 	/* ------------------------- */
 
 	template_t *templates;
 	uint templates_size;
 
 	void *render_thr;
-	void *candle_thr;
 	void *ticker_thr;
+	void *input_thr; /* owns the window and SDL's event queue */
 	int fps;
 	SDL_threadID render_id;
+	SDL_threadID input_id;
 	SDL_sem *sem;
+	SDL_sem *window_sem; /* posted once the input thread made the window */
 } candle_t;
 
 candle_t *candle_new(int comps_size, ...);
+candle_t *candle_new_headless(int comps_size, ...);
 void candle_wait(candle_t *self);
 void candle_reset_dir(candle_t *self);
+void candle_set_timestep(candle_t *self, float step, int max_steps);
+void candle_fast_forward(candle_t *self, int enabled);
 
 void candle_register_template(candle_t *self, const char *key, template_cb cb);
 int candle_import(candle_t *self, entity_t root, const char *map_name);
@@ -0,0 +1,164 @@
+#include "commands.h"
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+
+enum
+{
+	CMD_ENTITY_NEW,
+	CMD_ENTITY_DESTROY,
+	CMD_COMPONENT_ADD,
+	CMD_SIGNAL
+};
+
+typedef struct
+{
+	int type;
+	entity_t entity;
+	void *cb;
+	uint signal;
+	uint size; /* payload bytes following the command */
+} cmd_t;
+
+#define CMD_ALIGN 16
+#define CMD_STRIDE(size) ((sizeof(cmd_t) + (size) + CMD_ALIGN - 1) & \
+		~(CMD_ALIGN - 1))
+
+typedef struct cmd_buffer_t
+{
+	SDL_SpinLock lock;
+	char *data;
+	uint data_size;
+	uint data_alloc;
+	/* swapped with data by commands_flush, only it touches these */
+	char *flushing;
+	uint flushing_size;
+	uint flushing_alloc;
+	struct cmd_buffer_t *next;
+} cmd_buffer_t;
+
+static __thread cmd_buffer_t *g_buffer = NULL;
+static cmd_buffer_t *g_buffers = NULL;
+static SDL_SpinLock g_buffers_lock = 0;
+
+static cmd_buffer_t *cmd_buffer(void)
+{
+	if(!g_buffer)
+	{
+		g_buffer = calloc(1, sizeof(*g_buffer));
+		SDL_AtomicLock(&g_buffers_lock);
+		g_buffer->next = g_buffers;
+		g_buffers = g_buffer;
+		SDL_AtomicUnlock(&g_buffers_lock);
+	}
+	return g_buffer;
+}
+
+static void cmd_record(int type, entity_t entity, void *cb, uint signal,
+		const void *payload, uint size)
+{
+	cmd_buffer_t *self = cmd_buffer();
+	uint stride = CMD_STRIDE(size);
+
+	SDL_AtomicLock(&self->lock);
+	if(self->data_size + stride > self->data_alloc)
+	{
+		self->data_alloc = self->data_alloc ? self->data_alloc * 2 : 4096;
+		while(self->data_size + stride > self->data_alloc) self->data_alloc *= 2;
+		self->data = realloc(self->data, self->data_alloc);
+	}
+	cmd_t *cmd = (cmd_t*)&self->data[self->data_size];
+	*cmd = (cmd_t){.type = type, .entity = entity, .cb = cb,
+		.signal = signal, .size = size};
+	if(size) memcpy(cmd + 1, payload, size);
+	self->data_size += stride;
+	SDL_AtomicUnlock(&self->lock);
+}
+
+entity_t cmd_entity_new(cmd_entity_cb cb, const void *usrptr, uint size)
+{
+	/* the id is reserved now so later commands can refer to it */
+	entity_t entity = ecm_new_entity();
+	cmd_record(CMD_ENTITY_NEW, entity, cb, 0, usrptr, size);
+	return entity;
+}
+
+void cmd_entity_destroy(entity_t entity)
+{
+	cmd_record(CMD_ENTITY_DESTROY, entity, NULL, 0, NULL, 0);
+}
+
+void cmd_component_add(entity_t entity, cmd_component_cb cb,
+		const void *usrptr, uint size)
+{
+	cmd_record(CMD_COMPONENT_ADD, entity, cb, 0, usrptr, size);
+}
+
+void cmd_signal(entity_t entity, uint signal, const void *data)
+{
+	/* there would be nothing to copy, the listeners would get NULL */
+	assert(!data || g_ecm->signals[signal].size);
+	uint size = data ? g_ecm->signals[signal].size : 0;
+	cmd_record(CMD_SIGNAL, entity, NULL, signal, data, size);
+}
+
+static void cmd_run(cmd_t *cmd)
+{
+	void *payload = cmd->size ? cmd + 1 : NULL;
+	switch(cmd->type)
+	{
+		case CMD_ENTITY_NEW:
+			_g_creating[_g_creating_num++] = cmd->entity;
+			if(cmd->cb) ((cmd_entity_cb)cmd->cb)(payload);
+			_entity_new(0);
+			break;
+		case CMD_ENTITY_DESTROY:
+			entity_destroy(cmd->entity);
+			break;
+		case CMD_COMPONENT_ADD:
+			_entity_add_pre(cmd->entity);
+			_entity_add_post(cmd->entity,
+					((cmd_component_cb)cmd->cb)(payload));
+			break;
+		case CMD_SIGNAL:
+			entity_signal(cmd->entity, cmd->signal, payload);
+			break;
+	}
+}
+
+void commands_flush()
+{
+	cmd_buffer_t *buffers, *buffer;
+
+	SDL_AtomicLock(&g_buffers_lock);
+	buffers = g_buffers;
+	SDL_AtomicUnlock(&g_buffers_lock);
+
+	/* swap every buffer out before running any, commands recorded while
+	 * running then all wait for the next flush */
+	for(buffer = buffers; buffer; buffer = buffer->next)
+	{
+		SDL_AtomicLock(&buffer->lock);
+		char *recorded = buffer->data;
+		uint recorded_alloc = buffer->data_alloc;
+		buffer->flushing_size = buffer->data_size;
+		buffer->data = buffer->flushing;
+		buffer->data_alloc = buffer->flushing_alloc;
+		buffer->data_size = 0;
+		buffer->flushing = recorded;
+		buffer->flushing_alloc = recorded_alloc;
+		SDL_AtomicUnlock(&buffer->lock);
+	}
+
+	for(buffer = buffers; buffer; buffer = buffer->next)
+	{
+		char *recorded = buffer->flushing;
+		uint i;
+		for(i = 0; i < buffer->flushing_size;
+				i += CMD_STRIDE(((cmd_t*)&recorded[i])->size))
+		{
+			cmd_run((cmd_t*)&recorded[i]);
+		}
+		buffer->flushing_size = 0;
+	}
+}
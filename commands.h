@@ -0,0 +1,34 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <ecm.h>
+
+/* Structural changes and signals recorded from any thread and applied by
+ * commands_flush, which the ticker runs after every world_update.
+ * Payloads are copied, so usrptr may point to the caller's stack.
+ *
+ * Each thread records into its own buffer and the buffers are applied one
+ * after the other. Commands from the same thread run in the order they
+ * were recorded. Commands from different threads have no order between
+ * them, even when one thread recorded before another: a job destroying
+ * an entity and a job adding to it may run either way round, so anything
+ * that depends on order has to be recorded from one thread. Commands
+ * recorded while a flush runs them, by listeners for instance, run on the
+ * next flush. */
+
+/* runs the component constructors, as the arguments of entity_new would */
+typedef void(*cmd_entity_cb)(void *usrptr);
+/* returns the component to attach, as entity_add_component would take */
+typedef c_t*(*cmd_component_cb)(void *usrptr);
+
+entity_t cmd_entity_new(cmd_entity_cb cb, const void *usrptr, uint size);
+void cmd_entity_destroy(entity_t entity);
+void cmd_component_add(entity_t entity, cmd_component_cb cb,
+		const void *usrptr, uint size);
+/* data is copied at the signal's size, signals initialized with size 0
+ * take no data */
+void cmd_signal(entity_t entity, uint signal, const void *data);
+
+void commands_flush(void);
+
+#endif /* !COMMANDS_H */
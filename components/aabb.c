@@ -23,7 +23,10 @@ c_aabb_t *c_aabb_new()
 
 void c_aabb_update(c_aabb_t *self)
 {
-	mat4_t inv;
+	mat4_t axes;
+	vertex_t *max[3], *min[3];
+	vec3_t ext[6];
+	int i;
 
 	c_model_t *mc = c_model(self);
 
@@ -32,31 +35,27 @@ void c_aabb_update(c_aabb_t *self)
 			vec3_equals(sc->scale, self->sca)) return;
 	/* c_node_update_model(nc); */
 
+	if(!mc || !mc->mesh) return;
 	mesh_t *mesh = mc->mesh;
 
-	if(!mesh) return;
+	/* rows are the world axes in mesh space */
+	axes = mat4_transpose(mat4_invert(sc->rot_matrix));
 
-	inv = mat4_invert(sc->rot_matrix);
+	mesh_farthest_axes(mesh, axes, max, min);
+	if(!max[0]) return;
 
-	vec3_t dir_x = mat4_mul_vec4(inv, vec4(1.0, 0.0, 0.0, 0.0)).xyz;
-	vec3_t dir_y = mat4_mul_vec4(inv, vec4(0.0, 1.0, 0.0, 0.0)).xyz;
-	vec3_t dir_z = mat4_mul_vec4(inv, vec4(0.0, 0.0, 1.0, 0.0)).xyz;
+	for(i = 0; i < 3; i++)
+	{
+		ext[i] = XYZ(max[i]->pos);
+		ext[i + 3] = XYZ(min[i]->pos);
+	}
+	mat4_mul_dirs(sc->model_matrix, ext, ext, 6);
 
-	vec3_t max_x = XYZ(mesh_farthest(mesh,          dir_x )->pos);
-	vec3_t min_x = XYZ(mesh_farthest(mesh, vec3_inv(dir_x))->pos);
-
-	vec3_t max_y = XYZ(mesh_farthest(mesh,          dir_y )->pos);
-	vec3_t min_y = XYZ(mesh_farthest(mesh, vec3_inv(dir_y))->pos);
-
-	vec3_t max_z = XYZ(mesh_farthest(mesh,          dir_z )->pos);
-	vec3_t min_z = XYZ(mesh_farthest(mesh, vec3_inv(dir_z))->pos);
-
-	self->max.x = mat4_mul_vec4(sc->model_matrix, vec4(_vec3(max_x), 0.0)).x;
-	self->max.y = mat4_mul_vec4(sc->model_matrix, vec4(_vec3(max_y), 0.0)).y;
-	self->max.z = mat4_mul_vec4(sc->model_matrix, vec4(_vec3(max_z), 0.0)).z;
-	self->min.x = mat4_mul_vec4(sc->model_matrix, vec4(_vec3(min_x), 0.0)).x;
-	self->min.y = mat4_mul_vec4(sc->model_matrix, vec4(_vec3(min_y), 0.0)).y;
-	self->min.z = mat4_mul_vec4(sc->model_matrix, vec4(_vec3(min_z), 0.0)).z;
+	for(i = 0; i < 3; i++)
+	{
+		self->max._[i] = ext[i]._[i];
+		self->min._[i] = ext[i + 3]._[i];
+	}
 
 	self->max = vec3_add_number(self->max, mesh_get_margin(mesh));
 	self->min = vec3_sub_number(self->min, mesh_get_margin(mesh));
@@ -65,16 +64,36 @@ void c_aabb_update(c_aabb_t *self)
 	self->sca = sc->scale;
 }
 
-int c_aabb_on_mesh_change(c_aabb_t *self)
-{
-	c_aabb_update(self);
-	return 1;
-}
-
-int c_aabb_spacial_changed(c_aabb_t *self)
+void c_aabb_update_changed()
 {
-	c_aabb_update(self);
-	return 1;
+	static query_t *added, *moved, *remeshed;
+	static ulong since = 0;
+	ulong now;
+	uint i, n;
+
+	if(!added)
+	{
+		added = query_new(1, ct_aabb);
+		moved = query_new(2, ct_aabb, ct_spacial);
+		remeshed = query_new(2, ct_aabb, ct_model);
+	}
+	now = ecm_change_tick();
+
+	n = query_update_changed(added, 0, since);
+	for(i = 0; i < n; i++) c_aabb_update((c_aabb_t*)query_at(added, i)[0]);
+
+	n = query_update_changed(moved, 1, since);
+	for(i = 0; i < n; i++) c_aabb_update((c_aabb_t*)query_at(moved, i)[0]);
+
+	n = query_update_changed(remeshed, 1, since);
+	for(i = 0; i < n; i++)
+	{
+		c_aabb_t *self = (c_aabb_t*)query_at(remeshed, i)[0];
+		/* same orientation, but the box has to be taken again */
+		c_aabb_init(self);
+		c_aabb_update(self);
+	}
+	since = now;
 }
 
 int c_aabb_intersects(c_aabb_t *self, c_aabb_t *other)
@@ -97,8 +116,7 @@ void c_aabb_register()
 	ct_t *ct = ct_new("c_aabb", &ct_aabb, sizeof(c_aabb_t),
 			(init_cb)c_aabb_init, 1, ct_spacial);
 
-	ct_listener(ct, WORLD, mesh_changed, c_aabb_on_mesh_change);
-	ct_listener(ct, ENTITY, spacial_changed, c_aabb_spacial_changed);
+	/* boxes are refreshed by c_aabb_update_changed from the physics tick */
 
 	/* ct_listener(ct, WORLD, collider_callback, c_grid_collider); */
 }
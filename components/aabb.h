@@ -23,6 +23,9 @@ typedef struct
 DEF_CASTER(ct_aabb, c_aabb, c_aabb_t)
 
 c_aabb_t *c_aabb_new(void);
+/* ticker side, refreshes the boxes added, or whose spacial or model was
+ * written, since the previous call */
+void c_aabb_update_changed(void);
 
 void c_aabb_register(void);
 
@@ -24,7 +24,6 @@ c_camera_t *c_camera_new(float fov, float near, float far)
 	self->near = near;
 	self->far = far;
 	self->fov = fov;
-	self->view_cached = 0;
 	self->exposure = 0.25f;
 
 	c_camera_update(self, NULL);
@@ -40,7 +39,6 @@ c_camera_t *c_camera_clone(c_camera_t *self)
 	clone->near = self->near;
 	clone->far = self->far;
 	clone->fov = self->fov;
-	clone->view_cached = 0;
 	clone->exposure = self->exposure;
 
 	c_camera_update(self, NULL);
@@ -48,20 +46,14 @@ c_camera_t *c_camera_clone(c_camera_t *self)
 	return clone;
 }
 
-int c_camera_changed(c_camera_t *self)
-{
-	self->view_cached = 0;
-	return 1;
-}
-
-vec3_t c_camera_real_pos(c_camera_t *self, float depth, vec2_t coord)
+static vec3_t c_camera_unproject(c_camera_t *self, mat4_t viewInv,
+		float depth, vec2_t coord)
 {
 	/* float z = depth; */
     float z = depth * 2.0 - 1.0;
 	coord = vec2_sub_number(vec2_scale(coord, 2.0f), 1.0);
 
 	mat4_t projInv = mat4_invert(self->projection_matrix);
-	mat4_t viewInv = mat4_invert(self->view_matrix);
 
     vec4_t clipSpacePosition = vec4(_vec2(coord), z, 1.0);
     vec4_t viewSpacePosition = mat4_mul_vec4(projInv, clipSpacePosition);
@@ -74,14 +66,30 @@ vec3_t c_camera_real_pos(c_camera_t *self, float depth, vec2_t coord)
     return worldSpacePosition.xyz;
 }
 
+vec3_t c_camera_real_pos(c_camera_t *self, float depth, vec2_t coord)
+{
+	return c_camera_unproject(self, mat4_invert(self->view_matrix), depth,
+			coord);
+}
+
+vec3_t c_camera_live_real_pos(c_camera_t *self, float depth, vec2_t coord)
+{
+	c_node_t *node = c_node(self);
+	c_node_update_model(node);
+	return c_camera_unproject(self, node->model, depth, coord);
+}
 
 void c_camera_update_view(c_camera_t *self)
 {
-	if(self->view_cached) return;
-	c_node_t *n = c_node(self);
-	c_node_update_model(n);
-	self->pos = mat4_mul_vec4(n->model, vec4(0.0, 0.0, 0.0, 1.0)).xyz;
-	self->view_matrix = mat4_invert(n->model);
+	mat4_t model;
+	/* published transforms change every tick without raising
+	 * spacial_changed on this thread, until the first one the last view
+	 * is kept */
+	if(c_node_render_model(c_node(self), &model))
+	{
+		self->pos = mat4_mul_vec4(model, vec4(0.0, 0.0, 0.0, 1.0)).xyz;
+		self->view_matrix = mat4_invert(model);
+	}
 
 	self->vp = mat4_mul(self->projection_matrix, self->view_matrix);
 }
@@ -127,7 +135,6 @@ int c_camera_update(c_camera_t *self, void *event)
 		/* ((float)event->width / 2) / event->height, */
 		self->near, self->far
 	);
-	self->view_cached = 0;
 	return 1;
 }
 
@@ -136,7 +143,6 @@ void c_camera_register()
 	ct_t *ct = ct_new("c_camera", &ct_camera, sizeof(c_camera_t),
 			(init_cb)c_camera_init, 2, ct_spacial, ct_node);
 
-	ct_listener(ct, ENTITY, spacial_changed, c_camera_changed);
 	ct_listener(ct, WORLD, window_resize, c_camera_update);
 
 	ct_listener(ct, WORLD, component_menu, c_camera_component_menu);
@@ -12,7 +12,6 @@ typedef struct
 	mat4_t view_matrix;
 	mat4_t vp;
 	vec3_t pos;
-	int view_cached;
 	float near, far, fov;
 	float exposure;
 	int width;
@@ -23,8 +22,12 @@ DEF_CASTER(ct_camera, c_camera, c_camera_t)
 
 c_camera_t *c_camera_new(float fov, float near, float far);
 c_camera_t *c_camera_clone(c_camera_t *self);
+/* view_matrix, vp and pos belong to the render thread, which refreshes
+ * them from the interpolated node transform in c_camera_update_view */
 vec3_t c_camera_real_pos(c_camera_t *cam, float depth, vec2_t coord);
 void c_camera_update_view(c_camera_t *self);
+/* ticker side, unprojects through the node's live transform */
+vec3_t c_camera_live_real_pos(c_camera_t *cam, float depth, vec2_t coord);
 int c_camera_update(c_camera_t *self, void *event);
 void c_camera_activate(c_camera_t *self);
 
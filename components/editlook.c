@@ -44,7 +44,8 @@ int c_editlook_mouse_wheel(c_editlook_t *self, mouse_button_data *event)
 
 	float inc = 1.0f - (event->y * 0.1f);
 
-	c_spacial_set_pos(sc, vec3_mix(edit->mouse_position, sc->pos, inc));
+	c_spacial_set_pos(sc, vec3_mix(c_editmode_mouse_position(edit, NULL),
+				sc->pos, inc));
 
 	return 1;
 }
@@ -95,19 +96,23 @@ int c_editlook_mouse_move(c_editlook_t *self, mouse_move_data *event)
 	{
 		float px = fake_x / renderer->width;
 		float py = 1.0f - fake_y / renderer->height;
+		float depth;
+		vec3_t mouse_pos;
 
+		/* picks resolve on the render thread, so this is the last hover
+		 * pick, taken where the pan started */
+		mouse_pos = c_editmode_mouse_position(edit, &depth);
 		if(!self->panning)
 		{
 			self->panning = 1;
 			c_editmode_update_mouse(edit, fake_x, fake_y);
 
-			self->pan_diff = vec3_sub(sc->pos, edit->mouse_position);
+			self->pan_diff = vec3_sub(sc->pos, mouse_pos);
 		}
 
 		vec3_t old_pos = sc->pos;
 
-		c_camera_update_view(cam);
-		vec3_t pos = c_camera_real_pos(cam, edit->mouse_depth, vec2(px, py));
+		vec3_t pos = c_camera_live_real_pos(cam, depth, vec2(px, py));
 
 		vec3_t new_pos = vec3_add(self->pan_diff, pos);
 		c_spacial_set_pos(sc, new_pos);
@@ -117,8 +122,7 @@ int c_editlook_mouse_move(c_editlook_t *self, mouse_move_data *event)
 		self->pan_diff = vec3_sub(self->pan_diff, diff);
 
 
-		c_camera_update_view(cam);
-		new_pos = vec3_add(self->pan_diff, edit->mouse_position);
+		new_pos = vec3_add(self->pan_diff, mouse_pos);
 		c_spacial_set_pos(sc, new_pos);
 
 		return 0;
@@ -133,7 +137,7 @@ int c_editlook_mouse_move(c_editlook_t *self, mouse_move_data *event)
 
 	/* if(rot > max_up) rot = max_up; */
 	/* if(rot < max_down) rot = max_down; */
-	const vec3_t pivot = edit->mouse_position;
+	const vec3_t pivot = c_editmode_mouse_position(edit, NULL);
 
 	vec3_t diff = vec3_sub(sc->pos, pivot);
 	/* float radius = vec3_len(diff); */
@@ -37,7 +37,7 @@ static int c_freemove_update(c_freemove_t *self, float *dt)
 {
 	/* vec3_t rot = c_spacial(self->orientation)->rot; */
 	c_velocity_t *vc = c_velocity(self);
-	vec3_t *vel = &vc->velocity;
+	vec3_t *vel = &c_velocity_vel(vc);
 	float accel = 30 * (*dt);
 
 	c_spacial_t *sc = c_spacial(self);
@@ -79,7 +79,10 @@ static int c_freemove_update(c_freemove_t *self, float *dt)
 		*vel = vec3_add(*vel, front);
 	}
 
-	entity_signal(self->super.entity, spacial_changed, &self->super.entity);
+	if(self->left || self->right || self->forward || self->backward)
+	{
+		entity_signal(self->super.entity, spacial_changed, &self->super.entity);
+	}
 
 	return 1;
 }
@@ -120,5 +123,9 @@ void c_freemove_register()
 	ct_listener(ct, WORLD, key_down, c_freemove_key_down);
 
 	ct_listener(ct, WORLD, world_update, c_freemove_update);
+	ct_listener_reads(ct, world_update, 1, ct_spacial);
+	/* spacial_changed listeners run from the update */
+	ct_listener_writes(ct, world_update, 6, ct_velocity, ct_node, ct_aabb,
+			ct_model, ct_camera, ct_probe);
 }
 
@@ -44,6 +44,8 @@ static void mesh_gl_add_group(c_mesh_gl_t *self)
 
 static int c_mesh_gl_new_loader(c_mesh_gl_t *self)
 {
+	/* destroyed before the loader got to it */
+	if(!self) return 1;
 	mesh_gl_add_group(self);
 
 
@@ -521,6 +523,8 @@ static int glg_update_buffers(glg_t *self)
 void c_mesh_gl_update(c_mesh_gl_t *self)
 {
 	/* TODO update only dirty group */
+	/* mesh_changed is coalesced, the model may already hold a new mesh */
+	self->mesh = c_model(self)->mesh;
 	if(!self->mesh) return;
 	int i;
 	/* if(self->mesh->update_locked) return; */
@@ -653,12 +657,12 @@ int c_mesh_gl_draw(c_mesh_gl_t *self, shader_t *shader, int transparent)
 	int res = 1;
 		glerr();
 
+	c_mesh_gl_update(self);
 	if(!self->mesh)
 	{
 		return 0;
 	}
 
-	c_mesh_gl_update(self);
 
 	if(shader)
 	{
@@ -731,19 +735,6 @@ static void glg_destroy_loader(glg_t *self)
 
 }
 
-static int c_mesh_gl_destroy_loader(c_mesh_gl_t *self)
-{
-	int i;
-	for(i = 0; i < self->groups_num; i++)
-	{
-		glg_destroy_loader(&self->groups[i]);
-	}	
-	free(self->groups);
-	free(self);
-
-	return 1;
-}
-
 void glg_destroy(glg_t *self)
 {
 	if(self->tex) free(self->tex);
@@ -757,26 +748,71 @@ void glg_destroy(glg_t *self)
 
 }
 
-void c_mesh_gl_destroy(c_mesh_gl_t *self)
+/* the GL mirror isn't copied, instances build their own once their model
+ * raises mesh_changed on entity_created */
+static void c_mesh_gl_clone(c_mesh_gl_t *self)
+{
+	self->mesh = NULL;
+	self->groups_num = 0;
+	c_mesh_gl_init(self);
+}
+
+static void c_mesh_gl_release(c_mesh_gl_t *self)
+{
+	free(self->groups);
+}
+
+/* self is a copy made by c_mesh_gl_destroyed */
+static int c_mesh_gl_destroy_loader(c_mesh_gl_t *self)
 {
 	int i;
 	for(i = 0; i < self->groups_num; i++)
 	{
 		glg_destroy(&self->groups[i]);
+		glg_destroy_loader(&self->groups[i]);
 	}
+	free(self->groups);
+	free(self);
 
-	loader_push(candle->loader, (loader_cb)c_mesh_gl_destroy_loader, NULL,
-			(c_t*)self);
+	return 1;
+}
+
+/* The slot is reused once the entity is gone, but uploads queued on the
+ * loader still point into the groups. A copy takes them there, the loader
+ * runs in order so the buffers are deleted after the last upload. */
+static int c_mesh_gl_destroyed(c_mesh_gl_t *self)
+{
+	c_mesh_gl_t *copy = malloc(sizeof(*copy));
+	*copy = *self;
+	self->groups = NULL;
+	self->groups_num = 0;
+
+	if(candle->loader)
+	{
+		loader_push(candle->loader, (loader_cb)c_mesh_gl_destroy_loader, copy,
+				NULL);
+	}
+	else
+	{
+		free(copy->groups);
+		free(copy);
+	}
+	return 1;
 }
 
 void c_mesh_gl_register()
 {
 	ct_t *ct = ct_new("c_mesh_gl", &ct_mesh_gl,
 			sizeof(c_mesh_gl_t), (init_cb)c_mesh_gl_init, 0);
+	ct_set_transient(ct);
+	ct_set_clone(ct, (clone_cb)c_mesh_gl_clone, (clone_cb)c_mesh_gl_release);
 
 	ct_listener(ct, ENTITY, mesh_changed, c_mesh_gl_on_mesh_changed);
 
-	ct_add_interaction(ecm_get(ct_model), ct);
+	ct_listener(ct, ENTITY, entity_destroyed, c_mesh_gl_destroyed);
+
+	/* headless models keep their mesh for physics, but skip the GL mirror */
+	if(!candle->headless) ct_add_interaction(ecm_get(ct_model), ct);
 
 	/* ct_listener(ct, WORLD|RENDER_THREAD, component_menu, */
 			/* (signal_cb)c_mesh_gl_menu); */
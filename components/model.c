@@ -8,6 +8,9 @@
 #include <systems/renderer.h>
 #include "shader.h"
 #include <systems/editmode.h>
+#include <systems/sauces.h>
+#include <candle.h>
+#include <string.h>
 
 DEC_CT(ct_model);
 
@@ -61,6 +64,7 @@ c_model_t *c_model_new(mesh_t *mesh, mat_t *mat, int cast_shadow)
 
 c_model_t *c_model_paint(c_model_t *self, int layer, mat_t *mat)
 {
+	ct_write(ecm_get(ct_model), self);
 	self->layers[layer].mat = mat;
 	/* c_mesh_gl_t *gl = c_mesh_gl(self); */
 	/* gl->groups[layer].mat = mat; */
@@ -69,6 +73,7 @@ c_model_t *c_model_paint(c_model_t *self, int layer, mat_t *mat)
 
 c_model_t *c_model_cull_face(c_model_t *self, int layer, int inverted)
 {
+	ct_write(ecm_get(ct_model), self);
 	if(inverted == 0)
 	{
 		self->layers[layer].cull_front = 1;
@@ -95,17 +100,44 @@ c_model_t *c_model_cull_face(c_model_t *self, int layer, int inverted)
 
 c_model_t *c_model_wireframe(c_model_t *self, int layer, int wireframe)
 {
+	ct_write(ecm_get(ct_model), self);
 	self->layers[layer].wireframe = wireframe;
 	g_update_id++;
 	return self;
 }
 
+static int c_model_drop_mesh_loader(mesh_t *mesh)
+{
+	mesh_release(mesh);
+	return 1;
+}
+
+/* Drops a reference once nothing can still read the mesh through this
+ * model. mesh_changed listeners run at the next signals_flush and read
+ * model->mesh, so they only ever see the new one, but a frame in flight
+ * may be drawing the old one. The loader runs between frames. */
+static void c_model_drop_mesh(mesh_t *mesh)
+{
+	if(!mesh) return;
+	if(candle->loader)
+	{
+		loader_push(candle->loader, (loader_cb)c_model_drop_mesh_loader,
+				mesh, NULL);
+	}
+	else
+	{
+		mesh_release(mesh);
+	}
+}
+
 void c_model_set_mesh(c_model_t *self, mesh_t *mesh)
 {
+	ct_write(ecm_get(ct_model), self);
 	mesh_t *old_mesh = self->mesh;
 	self->mesh = mesh;
 	entity_signal_same(c_entity(self), mesh_changed, NULL);
-	if(old_mesh) mesh_destroy(old_mesh);
+	/* other instances of the same prefab may still use it */
+	c_model_drop_mesh(old_mesh);
 }
 
 int c_model_created(c_model_t *self)
@@ -133,8 +165,9 @@ int c_model_render_transparent(c_model_t *self, shader_t *shader)
 	c_node_t *node = c_node(self);
 	if(node)
 	{
-		c_node_update_model(node);
-		shader_update(shader, &node->model);
+		mat4_t model;
+		if(!c_node_render_model(node, &model)) return 1;
+		shader_update(shader, &model);
 	}
 
 	c_mesh_gl_draw(c_mesh_gl(self), shader, 1);
@@ -149,9 +182,9 @@ int c_model_render_visible(c_model_t *self, shader_t *shader)
 	c_node_t *node = c_node(self);
 	if(node)
 	{
-		c_node_update_model(node);
-
-		shader_update(shader, &node->model);
+		mat4_t model;
+		if(!c_node_render_model(node, &model)) return 1;
+		shader_update(shader, &model);
 	}
 
 	c_mesh_gl_draw(c_mesh_gl(self), shader, 0);
@@ -227,16 +260,87 @@ int c_model_scene_changed(c_model_t *self, entity_t *entity)
 	return 1;
 }
 
+/* meshes and materials are stored by name and resolved through sauces */
+static void c_model_save(c_model_t *self, FILE *fp)
+{
+	int i;
+	char name[256] = "";
+
+	if(self->mesh) strncpy(name, self->mesh->name, sizeof(name));
+	fwrite(name, sizeof(name), 1, fp);
+	for(i = 0; i < self->layers_num; i++)
+	{
+		mat_layer_t *layer = &self->layers[i];
+		memset(name, 0, sizeof(name));
+		if(layer->mat) strncpy(name, layer->mat->name, sizeof(name));
+		fwrite(layer, sizeof(*layer), 1, fp);
+		fwrite(name, sizeof(name), 1, fp);
+	}
+}
+
+static void c_model_load(c_model_t *self, FILE *fp)
+{
+	int i;
+	char name[256] = "";
+
+	self->mesh = NULL;
+	self->layers = malloc(sizeof(*self->layers) * 16);
+
+	if(fread(name, sizeof(name), 1, fp) == 1 && name[0])
+	{
+		self->mesh = sauces_mesh(name);
+	}
+	for(i = 0; i < self->layers_num; i++)
+	{
+		mat_layer_t *layer = &self->layers[i];
+		name[0] = '\0';
+		if(fread(layer, sizeof(*layer), 1, fp) != 1 ||
+				fread(name, sizeof(name), 1, fp) != 1) name[0] = '\0';
+		layer->mat = name[0] ? sauces_mat(name) : NULL;
+		if(!layer->mat) layer->mat = g_missing_mat;
+		layer->update_id = 0;
+	}
+}
+
+/* copies share the mesh but get their own layers */
+static void c_model_clone(c_model_t *self)
+{
+	mat_layer_t *layers = self->layers;
+	self->layers = malloc(sizeof(*self->layers) * 16);
+	memcpy(self->layers, layers, sizeof(*self->layers) * self->layers_num);
+	if(self->mesh) mesh_ref(self->mesh);
+}
+
+static void c_model_release(c_model_t *self)
+{
+	free(self->layers);
+	c_model_drop_mesh(self->mesh);
+}
+
+static int c_model_destroyed(c_model_t *self)
+{
+	c_model_release(self);
+	self->layers = NULL;
+	self->layers_num = 0;
+	self->mesh = NULL;
+	return 1;
+}
 
 void c_model_register()
 {
 	signal_init(&mesh_changed, sizeof(mesh_t));
+	signal_set_coalesce(mesh_changed, 1);
 
 	ct_t *ct = ct_new("c_model", &ct_model, sizeof(c_model_t),
 			(init_cb)c_model_init, 2, ct_spacial, ct_node);
 
+	ct_set_snapshot(ct, (snapshot_cb)c_model_save, (snapshot_cb)c_model_load);
+	ct_set_clone(ct, (clone_cb)c_model_clone, (clone_cb)c_model_release);
+
 	ct_listener(ct, ENTITY, entity_created, c_model_created);
 
+	ct_listener(ct, ENTITY, entity_destroyed, c_model_destroyed);
+
 	ct_listener(ct, WORLD, component_menu, c_model_menu);
 
 	ct_listener(ct, ENTITY, spacial_changed, c_model_scene_changed);
@@ -36,6 +36,7 @@ DEF_SIG(mesh_changed);
 DEF_CASTER(ct_model, c_model, c_model_t)
 extern int g_update_id;
 
+/* the model takes over the caller's reference to mesh, see mesh_ref */
 c_model_t *c_model_new(mesh_t *mesh, mat_t *mat, int cast_shadow);
 c_model_t *c_model_cull_face(c_model_t *self, int layer, int inverted);
 c_model_t *c_model_wireframe(c_model_t *self, int layer, int wireframe);
@@ -44,6 +45,7 @@ int c_model_render_transparent(c_model_t *self, shader_t *shader);
 int c_model_render_visible(c_model_t *self, shader_t *shader);
 int c_model_render(c_model_t *self, int transparent, shader_t *shader);
 void c_model_register(void);
+/* takes over the caller's reference and releases the previous mesh */
 void c_model_set_mesh(c_model_t *self, mesh_t *mesh);
 
 #endif /* !MODEL_H */
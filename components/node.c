@@ -5,9 +5,62 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <jobs.h>
 
 DEC_CT(ct_node);
 
+/* Every node in parents before children order, each root's subtree is
+ * contiguous so subtrees can be updated concurrently. Rebuilt whenever
+ * nodes are created, destroyed or reparented. */
+typedef struct
+{
+	c_node_t *node;
+	uint parent; /* index in g_flat, IDENT_NULL for roots */
+} node_flat_t;
+
+static node_flat_t *g_flat = NULL;
+static uint g_flat_size = 0;
+static uint g_flat_alloc = 0;
+/* start of each root's subtree in g_flat, plus g_flat_size at the end */
+static uint *g_roots = NULL;
+static uint g_roots_size = 0;
+static uint g_roots_alloc = 0;
+static int g_flat_dirty = 1;
+
+/* below this many nodes publishing doesn't go wide */
+#define NODE_PARALLEL_MIN 512
+
+/* World transforms published by the ticker for the render thread. Three
+ * frames rotate so neither side waits: the ticker fills back, swaps it
+ * with pending, and the renderer takes pending as front when it is newer
+ * than what it holds. */
+typedef struct
+{
+	mat4_t model;
+	node_trs_t trs; /* model decomposed */
+	node_trs_t prev; /* the transform one tick earlier, for interpolation */
+	entity_t entity;
+	ulong tick;
+} node_slot_t;
+
+typedef struct
+{
+	node_slot_t *slots;
+	uint slots_size;
+	ulong tick;
+	Uint64 time;
+	float step;
+} node_frame_t;
+
+#define FRAME_FRESH 4
+
+static node_frame_t g_frames[3];
+static int g_back = 0;
+static int g_front = 1;
+static SDL_atomic_t g_pending = {2};
+static ulong g_tick = 0;
+static float g_alpha = 1.0f;
+
 static void c_node_init(c_node_t *self)
 {
 	self->children = NULL;
@@ -15,6 +68,7 @@ static void c_node_init(c_node_t *self)
 	self->model = mat4();
 	self->cached = 0;
 	self->parent = entity_null;
+	g_flat_dirty = 1;
 }
 
 c_node_t *c_node_new()
@@ -23,14 +77,38 @@ c_node_t *c_node_new()
 	return self;
 }
 
+/* children notice through parent_version, no need to walk them */
 static int c_node_changed(c_node_t *self)
 {
-	ulong i;
 	self->cached = 0;
+	return 1;
+}
+
+static int c_node_destroyed(c_node_t *self)
+{
+	ulong i;
+	if(self->parent != entity_null)
+	{
+		c_node_t *parent = c_node(&self->parent);
+		if(parent) for(i = 0; i < parent->children_size; i++)
+		{
+			if(parent->children[i] != c_entity(self)) continue;
+
+			parent->children[i] = parent->children[--parent->children_size];
+			break;
+		}
+	}
 	for(i = 0; i < self->children_size; i++)
 	{
-		c_node_changed(c_node(&self->children[i]));
+		c_node_t *child = c_node(&self->children[i]);
+		if(!child) continue;
+		child->parent = entity_null;
+		c_node_changed(child);
 	}
+	free(self->children);
+	self->children = NULL;
+	self->children_size = 0;
+	g_flat_dirty = 1;
 	return 1;
 }
 
@@ -89,6 +167,35 @@ void c_node_add(c_node_t *self, int num, ...)
 	}
 
 	va_end(children);
+	g_flat_dirty = 1;
+}
+
+static void c_node_save(c_node_t *self, FILE *fp)
+{
+	fwrite(self->children, sizeof(*self->children), self->children_size, fp);
+}
+
+static void c_node_load(c_node_t *self, FILE *fp)
+{
+	self->cached = 0;
+	g_flat_dirty = 1;
+	self->children = malloc(sizeof(*self->children) * self->children_size);
+	if(fread(self->children, sizeof(*self->children), self->children_size,
+				fp) != self->children_size)
+	{
+		self->children_size = 0;
+	}
+}
+
+/* copies start detached, parent them with c_node_add */
+static void c_node_clone(c_node_t *self)
+{
+	self->children = NULL;
+	self->children_size = 0;
+	self->parent = entity_null;
+	self->cached = 0;
+	self->published_tick = 0;
+	g_flat_dirty = 1;
 }
 
 void c_node_register()
@@ -96,29 +203,238 @@ void c_node_register()
 	ct_t *ct = ct_new("c_node", &ct_node, sizeof(c_node_t),
 			(init_cb)c_node_init, 1, ct_spacial);
 
+	ct_set_snapshot(ct, (snapshot_cb)c_node_save, (snapshot_cb)c_node_load);
+	ct_set_clone(ct, (clone_cb)c_node_clone, NULL);
+
 	ct_listener(ct, ENTITY, spacial_changed, c_node_changed);
+
+	ct_listener(ct, ENTITY, entity_destroyed, c_node_destroyed);
 }
 
-void c_node_update_model(c_node_t *self)
+/* parent, when given, is already up to date */
+static inline void c_node_compute(c_node_t *self, c_node_t *parent)
 {
-	if(self->cached) return;
+	if(parent)
+	{
+		if(self->cached && self->parent_version == parent->version) return;
+		self->model = mat4_mul(parent->model, c_spacial(self)->model_matrix);
+		self->parent_version = parent->version;
+	}
+	else
+	{
+		if(self->cached) return;
+		/* self->model = mat4(); */
+		self->model = c_spacial(self)->model_matrix;
+	}
 	self->cached = 1;
+	self->version++;
+}
 
-	entity_t parent = self->parent;
+void c_node_update_model(c_node_t *self)
+{
+	c_node_t *parent = NULL;
 
 	if(self->parent != entity_null)
 	{
-		c_node_t *parent_node = c_node(&parent);
-		c_node_update_model(parent_node);
+		parent = c_node(&self->parent);
+		if(parent) c_node_update_model(parent);
+	}
+	c_node_compute(self, parent);
+}
 
-		self->model = mat4_mul(parent_node->model,
-				c_spacial(self)->model_matrix);
+static void c_node_flat_push(c_node_t *node, uint parent)
+{
+	if(g_flat_size == g_flat_alloc)
+	{
+		g_flat_alloc = g_flat_alloc ? g_flat_alloc * 2 : 64;
+		g_flat = realloc(g_flat, sizeof(*g_flat) * g_flat_alloc);
 	}
-	else
+	g_flat[g_flat_size++] = (node_flat_t){node, parent};
+}
+
+static void c_node_flatten(void)
+{
+	uint p, i, k;
+	ulong c;
+	ct_t *ct = ecm_get(ct_node);
+
+	g_flat_size = 0;
+	g_roots_size = 0;
+	for(p = 0; p < ct->pages_size; p++)
+	for(i = 0; i < ct->pages[p].components_size; i++)
 	{
-		/* self->model = mat4(); */
-		self->model = c_spacial(self)->model_matrix;
+		c_node_t *node = (c_node_t*)ct_get_at(ct, p, i);
+		if(node->parent != entity_null && c_node(&node->parent)) continue;
+
+		if(g_roots_size + 1 >= g_roots_alloc)
+		{
+			g_roots_alloc = g_roots_alloc ? g_roots_alloc * 2 : 64;
+			g_roots = realloc(g_roots, sizeof(*g_roots) * g_roots_alloc);
+		}
+		g_roots[g_roots_size++] = g_flat_size;
+
+		/* breadth first, everything appended is below the root */
+		c_node_flat_push(node, IDENT_NULL);
+		for(k = g_roots[g_roots_size - 1]; k < g_flat_size; k++)
+		{
+			c_node_t *parent = g_flat[k].node;
+			for(c = 0; c < parent->children_size; c++)
+			{
+				c_node_t *child = c_node(&parent->children[c]);
+				if(child) c_node_flat_push(child, k);
+			}
+		}
+	}
+	if(g_roots) g_roots[g_roots_size] = g_flat_size;
+	g_flat_dirty = 0;
+}
+
+/* shear from non-uniformly scaled parents doesn't survive, the exact model
+ * is still published for the end of the interpolation */
+static node_trs_t c_node_decompose(mat4_t M)
+{
+	node_trs_t t;
+	mat4_t R = mat4();
+	int i;
+
+	for(i = 0; i < 3; i++)
+	{
+		t.scale._[i] = vec3_len(M._[i].xyz);
+		if(t.scale._[i] > 1e-8f)
+			R._[i].xyz = vec3_scale(M._[i].xyz, 1.0f / t.scale._[i]);
 	}
+	/* a mirroring transform keeps a proper rotation and flips one axis */
+	if(vec3_dot(vec3_cross(R._[0].xyz, R._[1].xyz), R._[2].xyz) < 0.0f)
+	{
+		t.scale.x = -t.scale.x;
+		R._[0].xyz = vec3_scale(R._[0].xyz, -1.0f);
+	}
+	t.rot = vec4_norm(quat_from_mat4(R));
+	t.pos = M._[3].xyz;
+	return t;
+}
+
+static mat4_t c_node_compose(const node_trs_t *t)
+{
+	mat4_t M = mat4_from_quat(t->rot);
+	int i;
+	for(i = 0; i < 3; i++)
+		M._[i].xyz = vec3_scale(M._[i].xyz, t->scale._[i]);
+	M._[3].xyz = t->pos;
+	return M;
+}
+
+/* updates and publishes the subtrees of roots [start, end) */
+static void c_node_publish_roots(node_frame_t *frame, uint start, uint end)
+{
+	uint k;
+	for(k = g_roots[start]; k < g_roots[end]; k++)
+	{
+		node_flat_t *flat = &g_flat[k];
+		c_node_t *node = flat->node;
+		entity_t entity = c_entity(node);
+		node_slot_t *slot = &frame->slots[entity_index(entity)];
+
+		c_node_compute(node, flat->parent == IDENT_NULL ? NULL :
+				g_flat[flat->parent].node);
+
+		slot->model = node->model;
+		slot->trs = c_node_decompose(node->model);
+		slot->prev = node->published_tick &&
+			node->published_tick == frame->tick - 1 ?
+			node->published : slot->trs;
+		node->published = slot->trs;
+		node->published_tick = frame->tick;
+		slot->entity = entity;
+		slot->tick = frame->tick;
+	}
+}
+
+void c_node_publish(float step)
+{
+	node_frame_t *frame = &g_frames[g_back];
+
+	if(frame->slots_size < g_ecm->entities_size)
+	{
+		frame->slots = realloc(frame->slots, sizeof(*frame->slots) *
+				g_ecm->entities_size);
+		memset(&frame->slots[frame->slots_size], 0, sizeof(*frame->slots) *
+				(g_ecm->entities_size - frame->slots_size));
+		frame->slots_size = g_ecm->entities_size;
+	}
+	frame->tick = ++g_tick;
+	frame->step = step;
+
+	if(g_flat_dirty) c_node_flatten();
+
+	if(g_flat_size >= NODE_PARALLEL_MIN && g_roots_size > 1)
+	{
+		jobs_parallel_for(g_roots_size, 1, (range_cb)c_node_publish_roots,
+				frame);
+	}
+	else if(g_roots_size)
+	{
+		c_node_publish_roots(frame, 0, g_roots_size);
+	}
+
+	frame->time = SDL_GetPerformanceCounter();
+	SDL_MemoryBarrierRelease();
+	g_back = SDL_AtomicSet(&g_pending, g_back | FRAME_FRESH) & 3;
+}
+
+void c_node_acquire()
+{
+	node_frame_t *frame;
+	if(SDL_AtomicGet(&g_pending) & FRAME_FRESH)
+	{
+		g_front = SDL_AtomicSet(&g_pending, g_front) & 3;
+		SDL_MemoryBarrierAcquire();
+	}
+
+	/* draw one tick behind, blending towards the latest transform as the
+	 * next tick approaches */
+	frame = &g_frames[g_front];
+	g_alpha = 1.0f;
+	if(frame->step > 0.0f)
+	{
+		g_alpha = (SDL_GetPerformanceCounter() - frame->time) /
+			(double)SDL_GetPerformanceFrequency() / frame->step;
+		if(g_alpha > 1.0f) g_alpha = 1.0f;
+	}
+}
+
+const mat4_t *c_node_published(entity_t entity)
+{
+	node_frame_t *frame = &g_frames[g_front];
+	uint i = entity_index(entity);
+
+	if(i >= frame->slots_size) return NULL;
+	node_slot_t *slot = &frame->slots[i];
+	if(slot->entity != entity || slot->tick != frame->tick) return NULL;
+	return &slot->model;
+}
+
+int c_node_render_model(c_node_t *self, mat4_t *model)
+{
+	const mat4_t *published = c_node_published(c_entity(self));
+	const node_slot_t *slot;
+	node_trs_t t;
+
+	/* not published yet, the live transform belongs to the ticker and
+	 * spacial setters don't lock, so there is nothing safe to draw */
+	if(!published) return 0;
+
+	if(g_alpha >= 1.0f)
+	{
+		*model = *published;
+		return 1;
+	}
+	slot = (const node_slot_t*)published;
+	t.pos = vec3_mix(slot->prev.pos, slot->trs.pos, g_alpha);
+	t.scale = vec3_mix(slot->prev.scale, slot->trs.scale, g_alpha);
+	t.rot = quat_slerp(slot->prev.rot, slot->trs.rot, g_alpha);
+	*model = c_node_compose(&t);
+	return 1;
 }
 
 vec3_t c_node_global_to_local(c_node_t *self, vec3_t vec)
@@ -4,17 +4,33 @@
 #include "../glutil.h"
 #include <ecm.h>
 
+/* a world transform split up so it can be interpolated rigidly */
+typedef struct
+{
+	vec3_t pos;
+	vec3_t scale;
+	vec4_t rot;
+} node_trs_t;
+
 typedef struct
 {
 	c_t super; /* extends c_t */
 
 	mat4_t model;
 	int cached;
+	/* bumped every time model is recomputed, children compare it with
+	 * the parent_version they were computed against */
+	ulong version;
+	ulong parent_version;
 
 	entity_t *children;
 	ulong children_size;
 
 	entity_t parent;
+
+	/* last transform handed to c_node_publish */
+	node_trs_t published;
+	ulong published_tick;
 } c_node_t;
 
 DEF_CASTER(ct_node, c_node, c_node_t)
@@ -23,6 +39,18 @@ c_node_t *c_node_new(void);
 entity_t c_node_get_by_name(c_node_t *self, const char *name);
 void c_node_add(c_node_t *self, int num, ...);
 void c_node_update_model(c_node_t *self);
+
+/* ticker side, publishes the world transform of every node, step is the
+ * tick length used to interpolate, 0 disables interpolation */
+void c_node_publish(float step);
+/* render side, switches to the latest published transforms */
+void c_node_acquire(void);
+/* NULL until the entity's node has been published */
+const mat4_t *c_node_published(entity_t entity);
+/* the published transform, its position, rotation and scale interpolated
+ * from the previous tick, returns 0 and leaves model untouched until the
+ * node's first publish, callers skip drawing it */
+int c_node_render_model(c_node_t *self, mat4_t *model);
 vec3_t c_node_global_to_local(c_node_t *self, vec3_t vec);
 void c_node_register(void);
 
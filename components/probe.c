@@ -87,13 +87,46 @@ void c_probe_destroy(c_probe_t *self)
 	free(self);
 }
 
+static int c_probe_free_map_loader(texture_t *map)
+{
+	texture_destroy(map);
+	return 1;
+}
+
+/* every instance renders into its own cubemap */
+static void c_probe_clone(c_probe_t *self)
+{
+	texture_t *map = self->map;
+	self->last_update = 0;
+	if(!map) return;
+	self->map = texture_cubemap(map->width, map->height, map->depth_buffer);
+}
+
+static void c_probe_release(c_probe_t *self)
+{
+	if(!self->map) return;
+	loader_push(candle->loader, (loader_cb)c_probe_free_map_loader,
+			self->map, NULL);
+	self->map = NULL;
+}
+
+static int c_probe_destroyed(c_probe_t *self)
+{
+	c_probe_release(self);
+	return 1;
+}
+
 void c_probe_register()
 {
 	ct_t *ct = ct_new("c_probe", &ct_probe, sizeof(c_probe_t),
 			(init_cb)c_probe_init,
 			1, ct_spacial);
+	ct_set_transient(ct);
+	ct_set_clone(ct, (clone_cb)c_probe_clone, (clone_cb)c_probe_release);
 
 	ct_listener(ct, ENTITY, spacial_changed, c_probe_update_position);
+
+	ct_listener(ct, ENTITY, entity_destroyed, c_probe_destroyed);
 }
 
 
@@ -35,6 +35,9 @@ void c_spacial_register()
 			sizeof(c_spacial_t), (init_cb)c_spacial_init, 0);
 
 	signal_init(&spacial_changed, sizeof(entity_t));
+	/* several setters can run per entity and tick, listeners only need
+	 * the final transform */
+	signal_set_coalesce(spacial_changed, 1);
 
 	ct_listener(ct, WORLD, component_menu, c_spacial_menu);
 }
@@ -45,9 +48,8 @@ void c_spacial_unlock(c_spacial_t *self)
 	if(self->modified && self->lock_count == 0)
 	{
 		self->modified = 0;
+		/* raises spacial_changed */
 		c_spacial_update_model_matrix(self);
-		entity_signal(self->super.entity, spacial_changed,
-				&self->super.entity);
 	}
 }
 
@@ -198,6 +200,7 @@ void c_spacial_set_model(c_spacial_t *self, mat4_t model)
 
 void c_spacial_set_pos(c_spacial_t *self, vec3_t pos)
 {
+	if(vec3_equals(self->pos, pos)) return;
 	c_spacial_lock(self);
 	self->pos = pos;
 
@@ -268,6 +271,7 @@ int c_spacial_menu(c_spacial_t *self, void *ctx)
 
 void c_spacial_update_model_matrix(c_spacial_t *self)
 {
+	ct_write(ecm_get(ct_spacial), self);
 	self->model_matrix = mat4_translate(self->pos.x, self->pos.y,
 			self->pos.z);
 	self->model_matrix = mat4_mul(self->model_matrix, self->rot_matrix);
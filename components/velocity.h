@@ -8,16 +8,30 @@ typedef struct
 {
 	c_t super; /* extends c_t */
 
-	vec3_t pre_movement_pos;
-	vec3_t pre_collision_pos;
-	vec3_t computed_pos;
-
 	vec3_t normal;
-	vec3_t velocity;
 } c_velocity_t;
 
 DEF_CASTER(ct_velocity, c_velocity, c_velocity_t)
 
+/* fields integrated every tick are stored as columns */
+enum
+{
+	VEL_VELOCITY,
+	VEL_PRE_MOVEMENT_POS,
+	VEL_PRE_COLLISION_POS,
+	VEL_COMPUTED_POS,
+	VEL_COLUMNS
+};
+
+#define c_velocity_field(c, column) \
+	((vec3_t*)ct_field(ecm_get(ct_velocity), (c_t*)(c), column))
+#define c_velocity_vel(c) (*c_velocity_field(c, VEL_VELOCITY))
+#define c_velocity_pre_movement_pos(c) \
+	(*c_velocity_field(c, VEL_PRE_MOVEMENT_POS))
+#define c_velocity_pre_collision_pos(c) \
+	(*c_velocity_field(c, VEL_PRE_COLLISION_POS))
+#define c_velocity_computed_pos(c) (*c_velocity_field(c, VEL_COMPUTED_POS))
+
 c_velocity_t *c_velocity_new(float x, float y, float z);
 void c_velocity_init(c_velocity_t *self);
 void c_velocity_set_vel(c_velocity_t *self, float x, float y, float z);
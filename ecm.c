@@ -4,23 +4,32 @@
 #include <string.h>
 #include "ext.h"
 #include "ecm.h"
+#include "jobs.h"
 #include <stdarg.h>
 #include <SDL2/SDL.h>
 
 #include "candle.h"
 
 DEC_SIG(entity_created);
+DEC_SIG(entity_destroyed);
 SDL_sem *sem;
 
 listener_t *ct_get_listener(ct_t *self, uint signal)
 {
 	if(signal == IDENT_NULL) return NULL;
 	if(!self) return NULL;
+	if(signal < g_ecm->dispatch_signals && self->id < g_ecm->dispatch_cts)
+	{
+		return g_ecm->dispatch[self->id * g_ecm->dispatch_signals + signal];
+	}
+
+	/* dispatch table not generated yet */
 	uint i;
-	for(i = 0; i < self->listeners_size; i++)
+	signal_t *sig = &g_ecm->signals[signal];
+	for(i = 0; i < sig->listeners_size; i++)
 	{
-		listener_t *listener = &self->listeners[i];
-		if(listener->signal == signal)
+		listener_t *listener = &sig->listeners[i];
+		if(listener->comp_type == self->id)
 		{
 			return listener;
 		}
@@ -64,10 +73,13 @@ void ecm_init()
 	/* ecm_register("C_T", &g_ecm->global, sizeof(c_t), NULL, 0); */
 
 	signal_init(&entity_created, 0);
+	signal_init(&entity_destroyed, 0);
 
-	ecm_new_entity(); // entity_null
-
+	self->entities_free = 0;
+	self->change_tick = 1;
 	sem = SDL_CreateSemaphore(1);
+
+	ecm_new_entity(); // entity_null
 }
 
 void _ct_listener(ct_t *self, int flags, uint signal,
@@ -77,27 +89,176 @@ void _ct_listener(ct_t *self, int flags, uint signal,
 	if(signal == IDENT_NULL) return;
 	if(ct_get_listener(self, signal)) return;
 
-	uint i = self->listeners_size++;
-	self->listeners = realloc(self->listeners, sizeof(*self->listeners) *
-			self->listeners_size);
+	signal_t *sig = &g_ecm->signals[signal];
 
-	listener_t lis = {.signal = signal, .cb = (signal_cb)cb,
+	if(sig->listeners_size == sig->listeners_alloc)
+	{
+		sig->listeners_alloc = sig->listeners_alloc ? sig->listeners_alloc * 2 : 8;
+		sig->listeners = realloc(sig->listeners, sizeof(*sig->listeners) *
+				sig->listeners_alloc);
+	}
+	uint i = sig->listeners_size++;
+	sig->listeners[i] = (listener_t){.signal = signal, .cb = (signal_cb)cb,
 		.flags = flags, .comp_type = self->id};
-	self->listeners[i] = lis;
+	free(sig->schedule);
+	sig->schedule = NULL;
 
-	signal_t *sig = &g_ecm->signals[signal];
+	/* late registration, the table points into the listener arrays */
+	if(g_ecm->dispatch) ecm_generate_dispatch();
+}
 
-	i = sig->cts_size++;
-	sig->cts = realloc(sig->cts, sizeof(*sig->cts) * sig->cts_size);
-	sig->cts[i] = self->id;
+static void listener_set_access(listener_t *self, uint **list, uint *size,
+		int num, va_list cts)
+{
+	int i;
+	*size = 0;
+	*list = realloc(*list, sizeof(**list) * num);
+	for(i = 0; i < num; i++)
+	{
+		uint ct = va_arg(cts, uint);
+		/* not registered yet, the next registration pass fills it in */
+		if(ct != IDENT_NULL) (*list)[(*size)++] = ct;
+	}
+	self->declared = 1;
+
+	signal_t *sig = &g_ecm->signals[self->signal];
+	free(sig->schedule);
+	sig->schedule = NULL;
+}
 
-	i = sig->listeners_size++;
-	sig->listeners = realloc(sig->listeners, sizeof(*sig->listeners) *
-			sig->listeners_size);
-	sig->listeners[i] = lis;
+void ct_listener_reads(ct_t *self, uint signal, int num, ...)
+{
+	listener_t *listener = ct_get_listener(self, signal);
+	if(!listener) return;
+
+	va_list cts;
+	va_start(cts, num);
+	listener_set_access(listener, &listener->reads, &listener->reads_size,
+			num, cts);
+	va_end(cts);
 }
 
-void signal_init(uint *target, uint size)
+void ct_listener_writes(ct_t *self, uint signal, int num, ...)
+{
+	listener_t *listener = ct_get_listener(self, signal);
+	if(!listener) return;
+
+	va_list cts;
+	va_start(cts, num);
+	listener_set_access(listener, &listener->writes, &listener->writes_size,
+			num, cts);
+	va_end(cts);
+}
+
+void ct_listener_interval(ct_t *self, uint signal, uint interval)
+{
+	listener_t *listener = ct_get_listener(self, signal);
+	if(!listener) return;
+	listener->interval = interval;
+	listener->skipped = 0;
+	listener->elapsed = 0.0f;
+}
+
+void ct_listener_rate(ct_t *self, uint signal, float hz)
+{
+	listener_t *listener = ct_get_listener(self, signal);
+	if(!listener) return;
+	listener->period = hz > 0.0f ?
+		(Uint64)(SDL_GetPerformanceFrequency() / hz) : 0;
+	listener->next_run = 0;
+	listener->elapsed = 0.0f;
+}
+
+void ct_listener_budget(ct_t *self, uint signal, float seconds)
+{
+	listener_t *listener = ct_get_listener(self, signal);
+	if(!listener) return;
+	listener->budget = seconds > 0.0f ?
+		(Uint64)(SDL_GetPerformanceFrequency() * seconds) : 0;
+	listener->resume_page = listener->resume_slot = 0;
+	listener->clock = 0.0;
+	free(listener->visited_at);
+	listener->visited_at = NULL;
+	listener->visited_at_size = 0;
+}
+
+static int listener_writes(listener_t *self, uint ct)
+{
+	uint i;
+	if(self->comp_type == ct) return 1;
+	for(i = 0; i < self->writes_size; i++) if(self->writes[i] == ct) return 1;
+	return 0;
+}
+
+static int listener_touches(listener_t *self, uint ct)
+{
+	uint i;
+	if(listener_writes(self, ct)) return 1;
+	for(i = 0; i < self->reads_size; i++) if(self->reads[i] == ct) return 1;
+	return 0;
+}
+
+static int listener_conflicts(listener_t *a, listener_t *b)
+{
+	uint i;
+	if(!a->declared || !b->declared) return 1;
+
+	if(listener_touches(b, a->comp_type)) return 1;
+	if(listener_touches(a, b->comp_type)) return 1;
+	for(i = 0; i < a->writes_size; i++)
+	{
+		if(listener_touches(b, a->writes[i])) return 1;
+	}
+	for(i = 0; i < b->writes_size; i++)
+	{
+		if(listener_touches(a, b->writes[i])) return 1;
+	}
+	return 0;
+}
+
+void signal_build_schedule(signal_t *self)
+{
+	uint i, j;
+	uint *stage_of = calloc(self->listeners_size + 1, sizeof(*stage_of));
+
+	/* each listener runs after every earlier listener it conflicts with,
+	 * which keeps registration order wherever it matters */
+	self->stages_size = 0;
+	for(i = 0; i < self->listeners_size; i++)
+	{
+		for(j = 0; j < i; j++)
+		{
+			if(stage_of[j] >= stage_of[i] &&
+					listener_conflicts(&self->listeners[i], &self->listeners[j]))
+			{
+				stage_of[i] = stage_of[j] + 1;
+			}
+		}
+		if(stage_of[i] + 1 > self->stages_size)
+		{
+			self->stages_size = stage_of[i] + 1;
+		}
+	}
+
+	self->schedule = realloc(self->schedule,
+			sizeof(*self->schedule) * (self->listeners_size + 1));
+	self->stages = realloc(self->stages,
+			sizeof(*self->stages) * (self->stages_size + 1));
+
+	uint n = 0;
+	for(i = 0; i < self->stages_size; i++)
+	{
+		self->stages[i] = n;
+		for(j = 0; j < self->listeners_size; j++)
+		{
+			if(stage_of[j] == i) self->schedule[n++] = j;
+		}
+	}
+	self->stages[self->stages_size] = n;
+	free(stage_of);
+}
+
+void _signal_init(uint *target, uint size, const char *name)
 {
 	if(!g_ecm) return;
 	if(*target != IDENT_NULL) return;
@@ -106,32 +267,174 @@ void signal_init(uint *target, uint size)
 			g_ecm->signals_size);
 
 	g_ecm->signals[i] = (signal_t){.size = size};
+	/* name comes from the target expression, "&spacial_changed" */
+	if(*name == '&') name++;
+	strncpy(g_ecm->signals[i].name, name, sizeof(g_ecm->signals[i].name) - 1);
 
 	*target = i;
 }
 
-entity_t ecm_new_entity()
+#ifdef ECM_STATS
+void listener_stats_add(listener_t *self, Uint64 start, uint visited)
+{
+	Uint64 ticks = SDL_GetPerformanceCounter() - start;
+	Uint64 max;
+
+	__sync_fetch_and_add(&self->stats.calls, 1);
+	__sync_fetch_and_add(&self->stats.visited, visited);
+	__sync_fetch_and_add(&self->stats.ticks, ticks);
+	while((max = self->stats.max_ticks) < ticks)
+	{
+		if(__sync_bool_compare_and_swap(&self->stats.max_ticks, max, ticks))
+			break;
+	}
+}
+
+listener_stats_t *ecm_stats_get(uint signal, uint comp_type)
+{
+	if(signal == IDENT_NULL || comp_type == IDENT_NULL) return NULL;
+	listener_t *listener = ct_get_listener(ecm_get(comp_type), signal);
+	return listener ? &listener->stats : NULL;
+}
+
+void ecm_stats_reset()
+{
+	uint i, j;
+	for(i = 0; i < g_ecm->signals_size; i++)
+	{
+		signal_t *sig = &g_ecm->signals[i];
+		for(j = 0; j < sig->listeners_size; j++)
+		{
+			sig->listeners[j].stats = (listener_stats_t){0};
+		}
+	}
+}
+
+int ecm_stats_dump(const char *filename)
+{
+	uint i, j;
+	double freq = SDL_GetPerformanceFrequency();
+	FILE *fp = fopen(filename, "w");
+	if(!fp) return 0;
+
+	fprintf(fp, "signal,component,calls,visited,total_ms,max_ms\n");
+	for(i = 0; i < g_ecm->signals_size; i++)
+	{
+		signal_t *sig = &g_ecm->signals[i];
+		for(j = 0; j < sig->listeners_size; j++)
+		{
+			listener_t *lis = &sig->listeners[j];
+			fprintf(fp, "%s,%s,%lu,%lu,%f,%f\n", sig->name,
+					ecm_get(lis->comp_type)->name,
+					lis->stats.calls, lis->stats.visited,
+					lis->stats.ticks * 1000.0 / freq,
+					lis->stats.max_ticks * 1000.0 / freq);
+		}
+	}
+	fclose(fp);
+	return 1;
+}
+#endif
+
+void signal_set_coalesce(uint signal, int coalesce)
+{
+	if(signal == IDENT_NULL) return;
+	g_ecm->signals[signal].coalesce = coalesce;
+}
+
+void signal_set_accumulate(uint signal, int accumulate)
+{
+	if(signal == IDENT_NULL) return;
+	g_ecm->signals[signal].accumulate = accumulate;
+}
+
+/* callers hold sem */
+static entity_t ecm_alloc_entity(void)
 {
 	uint i;
-	int *iter;
 
+	if(g_ecm->entities_free)
+	{
+		i = g_ecm->entities_free;
+		g_ecm->entities_free = g_ecm->entities[i].next_free;
+	}
+	else
+	{
+		if(g_ecm->entities_size == g_ecm->entities_alloc)
+		{
+			uint new_alloc = g_ecm->entities_alloc ?
+				g_ecm->entities_alloc * 2 : 1024;
+			entity_slot_t *entities = malloc(sizeof(*entities) * new_alloc);
+			if(g_ecm->entities)
+			{
+				memcpy(entities, g_ecm->entities,
+						sizeof(*entities) * g_ecm->entities_size);
+				uint r = g_ecm->entities_retired_size++;
+				g_ecm->entities_retired = realloc(g_ecm->entities_retired,
+						sizeof(void*) * g_ecm->entities_retired_size);
+				g_ecm->entities_retired[r] = g_ecm->entities;
+			}
+			SDL_MemoryBarrierRelease();
+			g_ecm->entities = entities;
+			g_ecm->entities_alloc = new_alloc;
+		}
+		i = g_ecm->entities_size;
+		g_ecm->entities[i].generation = 0;
+		g_ecm->entities[i].next_free = IDENT_NULL;
+		SDL_MemoryBarrierRelease();
+		g_ecm->entities_size++;
+	}
+	g_ecm->entities[i].next_free = IDENT_NULL;
+	/* printf(">>>>>>>> %u\n", i); */
+	return entity_make(i, g_ecm->entities[i].generation);
+}
+
+entity_t ecm_new_entity()
+{
 	SDL_SemWait(sem);
-	for(i = 0, iter = g_ecm->entities_busy;
-			i < g_ecm->entities_busy_size && *iter; i++, iter++);
+	entity_t entity = ecm_alloc_entity();
+	SDL_SemPost(sem);
 
-	if(iter == NULL || i == g_ecm->entities_busy_size)
+	return entity;
+}
+
+void ecm_new_entities(uint count, entity_t *out)
+{
+	uint i;
+	SDL_SemWait(sem);
+	for(i = 0; i < count; i++) out[i] = ecm_alloc_entity();
+	SDL_SemPost(sem);
+}
+
+void ecm_free_entity(entity_t entity)
+{
+	if(entity == entity_null) return;
+	SDL_SemWait(sem);
+	if(ecm_entity_alive(entity))
 	{
-		i = g_ecm->entities_busy_size++;
-		g_ecm->entities_busy = realloc(g_ecm->entities_busy,
-				sizeof(*g_ecm->entities_busy) * g_ecm->entities_busy_size);
-		iter = &g_ecm->entities_busy[i];
+		uint i = entity_index(entity);
+		/* invalidates every outstanding handle to this slot */
+		g_ecm->entities[i].generation++;
+		g_ecm->entities[i].next_free = g_ecm->entities_free;
+		g_ecm->entities_free = i;
 	}
-
-	*iter = 1;
 	SDL_SemPost(sem);
-	/* printf(">>>>>>>> %u\n", i); */
+}
 
-	return i;
+int ecm_entity_alive(entity_t entity)
+{
+	uint i = entity_index(entity);
+	if(i >= g_ecm->entities_size) return 0;
+	SDL_MemoryBarrierAcquire();
+	entity_slot_t *slot = &g_ecm->entities[i];
+	return slot->next_free == IDENT_NULL &&
+		slot->generation == entity_gen(entity);
+}
+
+entity_t ecm_entity_at(uint index)
+{
+	if(index >= g_ecm->entities_size) return entity_null;
+	return entity_make(index, g_ecm->entities[index].generation);
 }
 
 void ct_add_interaction(ct_t *ct, ct_t *dep)
@@ -156,38 +459,177 @@ void ct_add_dependency(ct_t *ct, ct_t *dep)
 	ct->depends[i].is_interaction = 0;
 }
 
-/* void ecm_generate_hashes(ecm_t *self) */
-/* { */
-/* 	int i, j; */
-/* 	for(i = 0; i < self->cts_size; i++) */
-/* 	{ */
-/* 		ct_t *ct = &self->cts[i]; */
-/* 		ct->listeners_table = calloc(1, sizeof(*ct->listeners_table)); */
-/* 		int res = hcreate_r(ct->listeners_size, ct->listeners_table); */
-/* 		ENTRY item; */
-/* 		for(j = 0; j < ct->listeners_size; j++) */
-/* 		{ */
-/* 			listener_t *listener = &ct->listeners[j]; */
-/* 			item.data = listener; */
-/* 			item.key = listener->signal; */
-
-/* 			res = hsearch_r(item, ENTER, NULL, &ct->listeners_table); */
-/* 		} */
-/* 	} */
-/* } */
+void ecm_generate_dispatch()
+{
+	uint i, j;
+
+	free(g_ecm->dispatch);
+	g_ecm->dispatch = calloc(g_ecm->cts_size * g_ecm->signals_size,
+			sizeof(*g_ecm->dispatch));
+
+	for(i = 0; i < g_ecm->signals_size; i++)
+	{
+		signal_t *sig = &g_ecm->signals[i];
+		for(j = 0; j < sig->listeners_size; j++)
+		{
+			listener_t *listener = &sig->listeners[j];
+			g_ecm->dispatch[listener->comp_type * g_ecm->signals_size + i] =
+				listener;
+		}
+	}
+	g_ecm->dispatch_signals = g_ecm->signals_size;
+	g_ecm->dispatch_cts = g_ecm->cts_size;
+}
+
+/* Arrays read lock-free by ct_get and page iteration are never realloc'd in
+ * place: the grown copy is published and the old one kept alive. Growth is
+ * geometric, so retired memory never exceeds what is live. */
+static void *ct_grow(ct_t *self, void *array, uint size, uint new_size,
+		uint elem_size)
+{
+	void *grown = malloc(elem_size * new_size);
+	if(array)
+	{
+		memcpy(grown, array, elem_size * size);
+
+		uint i = self->retired_size++;
+		self->retired = realloc(self->retired,
+				sizeof(*self->retired) * self->retired_size);
+		self->retired[i] = array;
+	}
+	return grown;
+}
+
+#define PAGE_ALIGN(n) (((n) + 63) & ~(size_t)63)
+
+/* a page is one block: the components, the slot versions, the column
+ * pointers, then each column's packed array */
+static size_t ct_page_bytes(ct_t *self)
+{
+	uint c;
+	size_t bytes = PAGE_ALIGN((size_t)self->size * self->page_size);
+	bytes += PAGE_ALIGN(sizeof(ulong) * self->page_size);
+	if(self->columns_size)
+	{
+		bytes += PAGE_ALIGN(sizeof(char*) * self->columns_size);
+		for(c = 0; c < self->columns_size; c++)
+		{
+			bytes += PAGE_ALIGN((size_t)self->columns[c] * self->page_size);
+		}
+	}
+	return bytes;
+}
 
 struct comp_page *ct_add_page(ct_t *self)
 {
-	int page_id = self->pages_size++;
-	self->pages = realloc(self->pages, sizeof(*self->pages) * self->pages_size);
-	struct comp_page *page = &self->pages[page_id];
-	
-	page->components = malloc(self->size * PAGE_SIZE);
+	if(self->pages_size == self->pages_alloc)
+	{
+		uint new_alloc = self->pages_alloc ? self->pages_alloc * 2 : 4;
+		struct comp_page *pages = ct_grow(self, self->pages, self->pages_size,
+				new_alloc, sizeof(*self->pages));
+		SDL_MemoryBarrierRelease();
+		self->pages = pages;
+		self->pages_alloc = new_alloc;
+	}
+	struct comp_page *page = &self->pages[self->pages_size];
+
+	size_t bytes = ct_page_bytes(self);
+	char *block = arena_push(&self->arena, bytes);
+	/* past the reservation pages come from the heap */
+	if(!block) block = malloc(bytes);
+
+	size_t offset = PAGE_ALIGN((size_t)self->size * self->page_size);
+	page->components = block;
 	page->components_size = 0;
+	page->versions = (ulong*)(block + offset);
+	page->version = 0;
+	offset += PAGE_ALIGN(sizeof(ulong) * self->page_size);
+	page->columns = NULL;
+	if(self->columns_size)
+	{
+		uint c;
+		page->columns = (char**)(block + offset);
+		offset += PAGE_ALIGN(sizeof(char*) * self->columns_size);
+		for(c = 0; c < self->columns_size; c++)
+		{
+			page->columns[c] = block + offset;
+			offset += PAGE_ALIGN((size_t)self->columns[c] * self->page_size);
+		}
+	}
+	SDL_MemoryBarrierRelease();
+	self->pages_size++;
 	return page;
 
 }
 
+/* pages are only ever freed from the last one, so arena blocks pop in
+ * order */
+static void ct_free_page(ct_t *self, struct comp_page *page)
+{
+	if(arena_owns(&self->arena, page->components))
+	{
+		arena_pop(&self->arena, page->components);
+	}
+	else
+	{
+		free(page->components);
+	}
+}
+
+/* Layout changes are only allowed before the first component is added,
+ * the empty pages are dropped and rebuilt with the new layout. */
+static void ct_free_pages(ct_t *self)
+{
+	while(self->pages_size)
+	{
+		struct comp_page *page = &self->pages[--self->pages_size];
+		if(!arena_owns(&self->arena, page->components))
+		{
+			free(page->components);
+		}
+	}
+	arena_reset(&self->arena);
+}
+
+void ct_set_page_size(ct_t *self, uint page_size)
+{
+	if(!self || ct_count(self) || page_size == self->page_size) return;
+	ct_free_pages(self);
+	self->page_size = page_size;
+	ct_add_page(self);
+}
+
+void ct_set_arena(ct_t *self, size_t reserve, int huge_pages)
+{
+	if(!self || ct_count(self)) return;
+	ct_free_pages(self);
+	arena_release(&self->arena);
+	arena_init(&self->arena, reserve, huge_pages);
+	ct_add_page(self);
+}
+
+void ct_set_columns(ct_t *self, int num, ...)
+{
+	va_list sizes;
+	int i;
+
+	if(!self || ct_count(self)) return;
+
+	/* free the current pages while columns_size still matches them */
+	ct_free_pages(self);
+
+	self->columns = realloc(self->columns, sizeof(*self->columns) * num);
+	self->columns_size = num;
+	va_start(sizes, num);
+	for(i = 0; i < num; i++)
+	{
+		self->columns[i] = va_arg(sizes, size_t);
+	}
+	va_end(sizes);
+
+	ct_add_page(self);
+}
+
 ct_t *ct_new(const char *name, uint *target, uint size,
 		init_cb init, int depend_size, ...)
 {
@@ -219,8 +661,12 @@ ct_t *ct_new(const char *name, uint *target, uint size,
 		.size = size,
 		.depends_size = depend_size,
 		.is_interaction = 0,
-		.pages_size = 0
+		.pages_size = 0,
+		.page_size = PAGE_SIZE,
+		.mutex = SDL_CreateMutex()
 	};
+	/* without a reservation every page falls back to the heap */
+	arena_init(&ct->arena, CT_ARENA_RESERVE, 0);
 	strncpy(ct->name, name, sizeof(ct->name));
 
 	if(depend_size)
@@ -241,53 +687,835 @@ ct_t *ct_new(const char *name, uint *target, uint size,
 	return ct;
 }
 
-static SDL_mutex *mut = NULL;
+/* readers load the entry with ct_index_load */
+static void ct_index_store(struct comp_index *index, uint page, uint offset)
+{
+	struct comp_index value = {page, offset};
+	__atomic_store(index, &value, __ATOMIC_RELEASE);
+}
+
+static struct comp_index *ct_index_alloc(ct_t *self, uint i)
+{
+	uint p = i / SPARSE_PAGE;
+
+	if(p >= self->sparse_size)
+	{
+		uint new_size = self->sparse_size ? self->sparse_size : 4;
+		while(new_size <= p) new_size *= 2;
+
+		struct comp_index **sparse = ct_grow(self, self->sparse,
+				self->sparse_size, new_size, sizeof(*self->sparse));
+		memset(&sparse[self->sparse_size], 0,
+				sizeof(*sparse) * (new_size - self->sparse_size));
+		SDL_MemoryBarrierRelease();
+		self->sparse = sparse;
+		SDL_MemoryBarrierRelease();
+		self->sparse_size = new_size;
+	}
+	if(!self->sparse[p])
+	{
+		struct comp_index *page = malloc(sizeof(*page) * SPARSE_PAGE);
+		memset(page, 0xff, sizeof(*page) * SPARSE_PAGE);
+		SDL_MemoryBarrierRelease();
+		self->sparse[p] = page;
+	}
+	return &self->sparse[p][i % SPARSE_PAGE];
+}
+
 c_t *ct_add(ct_t *self, entity_t entity)
 {
-	if(!mut) SDL_CreateMutex();
-	SDL_LockMutex(mut);
 	if(!self) return NULL;
+	SDL_LockMutex(self->mutex);
 
 	int page_id = self->pages_size - 1;
 	struct comp_page *page = &self->pages[page_id];
-	if(page->components_size == PAGE_SIZE)
+	if(page->components_size == self->page_size)
 	{
 		page = ct_add_page(self);
 		page_id++;
 	}
 
-	uint offset;
+	uint j, offset;
+	struct comp_index *index = ct_index_alloc(self, entity_index(entity));
+
+	/* printf("c_size %d %s\n", (int)self->size, self->name); */
+
+	offset = page->components_size * self->size;
+	c_t *comp = (c_t*)&page->components[offset];
+	memset(comp, 0, self->size);
+	for(j = 0; j < self->columns_size; j++)
+	{
+		memset(&page->columns[j][page->components_size * self->columns[j]], 0,
+				self->columns[j]);
+	}
+	comp->entity = entity;
+	comp->comp_type = self->id;
+	page->versions[page->components_size] = page->version =
+		g_ecm->change_tick;
+
+	/* publish only once the slot is initialized */
+	ct_index_store(index, page_id, offset);
+
+	page->components_size++;
+	__sync_fetch_and_add(&g_ecm->version, 1);
 
+	SDL_UnlockMutex(self->mutex);
+	return comp;
+}
 
-	if(entity >= self->offsets_size)
+/* adds count copies of src, columns holds one element per column */
+static void ct_add_copies(ct_t *self, const entity_t *entities, uint count,
+		const c_t *src, char **columns)
+{
+	uint i = 0, j, c;
+	SDL_LockMutex(self->mutex);
+	while(i < count)
 	{
-		/* printf("increasing offsets %d -> %d\n", self->offsets_size, (int)entity + 1); */
-		uint j, new_size = entity + 1;
-		self->offsets = realloc(self->offsets, sizeof(*self->offsets) *
-				new_size);
-		for(j = self->offsets_size; j < new_size - 1; j++)
+		int page_id = self->pages_size - 1;
+		struct comp_page *page = &self->pages[page_id];
+		if(page->components_size == self->page_size)
 		{
-			self->offsets[j].offset = -1;
+			page = ct_add_page(self);
+			page_id++;
 		}
+		uint first = page->components_size;
+		uint run = self->page_size - first;
+		if(run > count - i) run = count - i;
 
+		for(j = 0; j < run; j++)
+		{
+			c_t *comp = (c_t*)&page->components[(first + j) * self->size];
+			memcpy(comp, src, self->size);
+			comp->entity = entities[i + j];
+			for(c = 0; c < self->columns_size; c++)
+			{
+				memcpy(&page->columns[c][(first + j) * self->columns[c]],
+						columns[c], self->columns[c]);
+			}
+		}
+		for(j = 0; j < run; j++)
+		{
+			page->versions[first + j] = g_ecm->change_tick;
+		}
+		page->version = g_ecm->change_tick;
+		for(j = 0; j < run; j++)
+		{
+			struct comp_index *index = ct_index_alloc(self,
+					entity_index(entities[i + j]));
+			ct_index_store(index, page_id, (first + j) * self->size);
+		}
+		page->components_size += run;
+		i += run;
 	}
-	/* printf("c_size %d %s\n", (int)self->size, self->name); */
+	__sync_fetch_and_add(&g_ecm->version, 1);
+	SDL_UnlockMutex(self->mutex);
+}
 
-	self->offsets[entity].offset = offset = page->components_size * self->size;
-	self->offsets[entity].page = page_id;
+void ct_remove(ct_t *self, entity_t entity)
+{
+	if(!self) return;
+	c_t *comp = ct_get(self, entity);
+	if(!comp || comp->entity != entity) return;
 
+	component_signal(comp, self, entity_destroyed, NULL);
 
-	page->components_size++;
+	SDL_LockMutex(self->mutex);
+	/* another remove may have moved it since the lookup above */
+	struct comp_index *index = ct_index(self, entity_index(entity));
+	if(index->offset == -1)
+	{
+		SDL_UnlockMutex(self->mutex);
+		return;
+	}
+	uint page_id = index->page;
+	uint offset = index->offset;
+	comp = (c_t*)&self->pages[page_id].components[offset];
 
-	if(entity >= self->offsets_size)
+	/* only the last page can be partially filled, move its last component
+	 * into the hole so pages stay packed */
+	struct comp_page *last_page = &self->pages[self->pages_size - 1];
+	c_t *last = (c_t*)&last_page->components[
+		(last_page->components_size - 1) * self->size];
+
+	if(last != comp)
 	{
-		self->offsets_size = entity + 1;
+		uint c, last_slot = last_page->components_size - 1;
+		uint slot = offset / self->size;
+		struct comp_page *page = &self->pages[page_id];
+		for(c = 0; c < self->columns_size; c++)
+		{
+			memcpy(&page->columns[c][slot * self->columns[c]],
+					&last_page->columns[c][last_slot * self->columns[c]],
+					self->columns[c]);
+		}
+		memcpy(comp, last, self->size);
+		page->versions[slot] = last_page->versions[last_slot];
+		if(page->version < page->versions[slot])
+		{
+			page->version = page->versions[slot];
+		}
+		struct comp_index *moved = ct_index(self, entity_index(comp->entity));
+		ct_index_store(moved, page_id, offset);
+	}
+	last_page->components_size--;
+	ct_index_store(index, -1, -1);
+	__sync_fetch_and_add(&g_ecm->version, 1);
+
+	if(last_page->components_size == 0 && self->pages_size > 1)
+	{
+		self->pages_size--;
+		ct_free_page(self, last_page);
+	}
+	SDL_UnlockMutex(self->mutex);
+}
+
+uint ct_count(ct_t *self)
+{
+	if(!self->pages_size) return 0;
+	return (self->pages_size - 1) * self->page_size +
+		self->pages[self->pages_size - 1].components_size;
+}
+
+typedef struct
+{
+	ct_t *ct;
+	foreach_cb cb;
+	void *usrptr;
+} ct_foreach_t;
+
+static void ct_foreach_pages(ct_foreach_t *self, uint start, uint end)
+{
+	uint p, i;
+	for(p = start; p < end; p++)
+	for(i = 0; i < self->ct->pages[p].components_size; i++)
+	{
+		self->cb(ct_get_at(self->ct, p, i), self->usrptr);
 	}
-	SDL_UnlockMutex(mut);
-	c_t *comp = (c_t*)&page->components[offset];
-	memset(comp, 0, self->size);
-	comp->entity = entity;
-	comp->comp_type = self->id;
-	return comp;
 }
 
+void ct_parallel_for(ct_t *self, foreach_cb cb, void *usrptr)
+{
+	ct_foreach_t foreach = {self, cb, usrptr};
+	jobs_parallel_for(self->pages_size, 1, (range_cb)ct_foreach_pages,
+			&foreach);
+}
+
+query_t *query_new(int cts_size, ...)
+{
+	if(cts_size < 1 || cts_size > QUERY_MAX_CTS) return NULL;
+
+	query_t *self = calloc(1, sizeof *self);
+	va_list cts;
+
+	va_start(cts, cts_size);
+	for(self->cts_size = 0; self->cts_size < cts_size; self->cts_size++)
+	{
+		self->cts[self->cts_size] = va_arg(cts, uint);
+	}
+	va_end(cts);
+
+	/* force a build on the first update */
+	self->version = g_ecm->version - 1;
+
+	return self;
+}
+
+uint query_update(query_t *self)
+{
+	uint i, n, p, smallest = 0;
+	ct_t *cts[QUERY_MAX_CTS];
+
+	if(self->version == g_ecm->version) return self->tuples_size;
+	self->version = g_ecm->version;
+	self->tuples_size = 0;
+	if(self->cts_size < 1) return 0;
+
+	for(n = 0; n < self->cts_size; n++)
+	{
+		if(self->cts[n] == IDENT_NULL) return 0;
+		cts[n] = ecm_get(self->cts[n]);
+		if(ct_count(cts[n]) < ct_count(cts[smallest])) smallest = n;
+	}
+
+	/* drive the match from the rarest type, everything else is a lookup */
+	ct_t *driver = cts[smallest];
+	for(p = 0; p < driver->pages_size; p++)
+	for(i = 0; i < driver->pages[p].components_size; i++)
+	{
+		entity_t entity = c_entity(ct_get_at(driver, p, i));
+
+		if(self->tuples_size == self->tuples_alloc)
+		{
+			self->tuples_alloc = self->tuples_alloc ? self->tuples_alloc * 2 : 32;
+			self->tuples = realloc(self->tuples, sizeof(*self->tuples) *
+					self->tuples_alloc * self->cts_size);
+		}
+		c_t **tuple = query_at(self, self->tuples_size);
+
+		for(n = 0; n < self->cts_size; n++)
+		{
+			if(!(tuple[n] = ct_get(cts[n], entity))) break;
+		}
+		if(n == self->cts_size) self->tuples_size++;
+	}
+
+	return self->tuples_size;
+}
+
+ulong ecm_change_tick()
+{
+	return __sync_fetch_and_add(&g_ecm->change_tick, 1);
+}
+
+uint query_update_changed(query_t *self, uint filter, ulong since)
+{
+	uint i, n, p;
+	ct_t *cts[QUERY_MAX_CTS];
+
+	/* the cached match is overwritten, rebuild it on the next update */
+	self->version = g_ecm->version - 1;
+	self->tuples_size = 0;
+	if(filter >= self->cts_size) return 0;
+
+	for(n = 0; n < self->cts_size; n++)
+	{
+		if(self->cts[n] == IDENT_NULL) return 0;
+		cts[n] = ecm_get(self->cts[n]);
+	}
+
+	ct_t *driver = cts[filter];
+	for(p = 0; p < driver->pages_size; p++)
+	{
+		struct comp_page *page = &driver->pages[p];
+		if(page->version <= since) continue;
+
+		for(i = 0; i < page->components_size; i++)
+		{
+			if(page->versions[i] <= since) continue;
+			entity_t entity = c_entity(ct_get_at(driver, p, i));
+
+			if(self->tuples_size == self->tuples_alloc)
+			{
+				self->tuples_alloc = self->tuples_alloc ?
+					self->tuples_alloc * 2 : 32;
+				self->tuples = realloc(self->tuples, sizeof(*self->tuples) *
+						self->tuples_alloc * self->cts_size);
+			}
+			c_t **tuple = query_at(self, self->tuples_size);
+
+			for(n = 0; n < self->cts_size; n++)
+			{
+				if(!(tuple[n] = ct_get(cts[n], entity))) break;
+			}
+			if(n == self->cts_size) self->tuples_size++;
+		}
+	}
+
+	return self->tuples_size;
+}
+
+void query_destroy(query_t *self)
+{
+	free(self->tuples);
+	free(self);
+}
+
+void ct_set_snapshot(ct_t *self, snapshot_cb save, snapshot_cb load)
+{
+	if(!self) return;
+	self->save = save;
+	self->load = load;
+}
+
+void ct_set_transient(ct_t *self)
+{
+	if(!self) return;
+	self->transient = 1;
+}
+
+void ct_set_clone(ct_t *self, clone_cb clone, clone_cb release)
+{
+	if(!self) return;
+	self->clone = clone;
+	self->release = release;
+}
+
+prefab_t *prefab_new(entity_t source)
+{
+	uint i, c;
+	prefab_t *self = calloc(1, sizeof *self);
+
+	for(i = 0; i < g_ecm->cts_size; i++)
+	{
+		ct_t *ct = &g_ecm->cts[i];
+		c_t *comp = ct_get(ct, source);
+		if(!comp) continue;
+		if(ct->transient && !ct->clone)
+		{
+			prefab_destroy(self);
+			return NULL;
+		}
+
+		uint j = self->comps_size++;
+		self->comps = realloc(self->comps,
+				sizeof(*self->comps) * self->comps_size);
+		prefab_comp_t *pc = &self->comps[j];
+		pc->ct = ct->id;
+		pc->columns = NULL;
+		pc->data = malloc(ct->size);
+		memcpy(pc->data, comp, ct->size);
+		/* keep nothing shared with the source, it may go away first */
+		if(ct->clone) ct->clone(pc->data);
+		if(ct->columns_size)
+		{
+			pc->columns = malloc(sizeof(*pc->columns) * ct->columns_size);
+			for(c = 0; c < ct->columns_size; c++)
+			{
+				pc->columns[c] = malloc(ct->columns[c]);
+				memcpy(pc->columns[c], ct_field(ct, comp, c), ct->columns[c]);
+			}
+		}
+	}
+	return self;
+}
+
+void prefab_spawn(prefab_t *self, uint count, entity_t *out)
+{
+	uint i, j;
+	if(!count) return;
+
+	ecm_new_entities(count, out);
+
+	for(i = 0; i < self->comps_size; i++)
+	{
+		prefab_comp_t *pc = &self->comps[i];
+		ct_t *ct = ecm_get(pc->ct);
+
+		ct_add_copies(ct, out, count, pc->data, pc->columns);
+		if(ct->clone) for(j = 0; j < count; j++)
+		{
+			ct->clone(ct_get(ct, out[j]));
+		}
+	}
+
+	entity_signal_same_batch(out, count, entity_created, NULL);
+}
+
+void prefab_destroy(prefab_t *self)
+{
+	uint i, c;
+	for(i = 0; i < self->comps_size; i++)
+	{
+		prefab_comp_t *pc = &self->comps[i];
+		if(pc->columns)
+		{
+			for(c = 0; c < ecm_get(pc->ct)->columns_size; c++)
+			{
+				free(pc->columns[c]);
+			}
+			free(pc->columns);
+		}
+		/* the copy owns whatever its clone hook duplicated */
+		if(ecm_get(pc->ct)->release)
+		{
+			ecm_get(pc->ct)->release(pc->data);
+		}
+		free(pc->data);
+	}
+	free(self->comps);
+	free(self);
+}
+
+#define SNAPSHOT_MAGIC 0x50414e53 /* "SNAP" */
+#define SNAPSHOT_VERSION 3
+
+static int ecm_has_persistent(entity_t entity)
+{
+	uint i;
+	for(i = 0; i < g_ecm->cts_size; i++)
+	{
+		ct_t *ct = &g_ecm->cts[i];
+		if(!ct->transient && ct_get(ct, entity)) return 1;
+	}
+	return 0;
+}
+
+/* Layout: header, entity slots, then every persistent type's name,
+ * descriptor and pages, then the byte size of the hook data and the save
+ * hook output of each type in the same order. Keeping the opaque hook data
+ * last lets ecm_load read and check all the pages, and that the hook data
+ * is all there, before touching the world. The size is patched in
+ * afterwards, so fp must be seekable. */
+int ecm_save(FILE *fp)
+{
+	uint i, p, c, j, cts_size = 0, hooks_size = 0;
+	long hooks, end;
+	uint header[] = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, g_ecm->entities_size};
+
+	for(i = 0; i < g_ecm->cts_size; i++)
+	{
+		if(!g_ecm->cts[i].transient) cts_size++;
+	}
+
+	fwrite(header, sizeof(header), 1, fp);
+	fwrite(g_ecm->entities, sizeof(*g_ecm->entities), g_ecm->entities_size, fp);
+	fwrite(&cts_size, sizeof(cts_size), 1, fp);
+
+	for(i = 0; i < g_ecm->cts_size; i++)
+	{
+		ct_t *ct = &g_ecm->cts[i];
+		if(ct->transient) continue;
+
+		uint desc[] = {ct->size, ct->page_size, ct->columns_size,
+			ct->pages_size};
+		fwrite(ct->name, sizeof(ct->name), 1, fp);
+		fwrite(desc, sizeof(desc), 1, fp);
+		fwrite(ct->columns, sizeof(*ct->columns), ct->columns_size, fp);
+
+		for(p = 0; p < ct->pages_size; p++)
+		{
+			struct comp_page *page = &ct->pages[p];
+			fwrite(&page->components_size, sizeof(uint), 1, fp);
+			fwrite(page->components, ct->size, page->components_size, fp);
+			for(c = 0; c < ct->columns_size; c++)
+			{
+				fwrite(page->columns[c], ct->columns[c],
+						page->components_size, fp);
+			}
+		}
+	}
+	hooks = ftell(fp);
+	fwrite(&hooks_size, sizeof(hooks_size), 1, fp);
+	for(i = 0; i < g_ecm->cts_size; i++)
+	{
+		ct_t *ct = &g_ecm->cts[i];
+		if(ct->transient || !ct->save) continue;
+
+		for(p = 0; p < ct->pages_size; p++)
+		for(j = 0; j < ct->pages[p].components_size; j++)
+		{
+			ct->save(ct_get_at(ct, p, j), fp);
+		}
+	}
+	end = ftell(fp);
+	if(hooks < 0 || end < 0) return 0;
+	hooks_size = end - hooks - sizeof(hooks_size);
+	if(fseek(fp, hooks, SEEK_SET)) return 0;
+	fwrite(&hooks_size, sizeof(hooks_size), 1, fp);
+	if(fseek(fp, end, SEEK_SET)) return 0;
+	return !ferror(fp);
+}
+
+/* whether fp still holds size bytes past the current position */
+static int ecm_has_bytes(FILE *fp, uint size)
+{
+	long at = ftell(fp), end;
+	if(at < 0 || fseek(fp, 0, SEEK_END)) return 0;
+	end = ftell(fp);
+	if(fseek(fp, at, SEEK_SET)) return 0;
+	return end >= at && (unsigned long)(end - at) >= size;
+}
+
+static ct_t *ecm_find_ct(const char *name)
+{
+	uint i;
+	for(i = 0; i < g_ecm->cts_size; i++)
+	{
+		if(!strncmp(g_ecm->cts[i].name, name, sizeof(g_ecm->cts[i].name)))
+			return &g_ecm->cts[i];
+	}
+	return NULL;
+}
+
+/* a type's pages as read from a snapshot, not yet in the world */
+typedef struct
+{
+	ct_t *ct;
+	uint pages_size;
+	uint *sizes;
+	char **data; /* components then each column, per page */
+} ct_stage_t;
+
+static void ct_stage_free(ct_stage_t *self)
+{
+	uint p;
+	for(p = 0; p < self->pages_size; p++) free(self->data[p]);
+	free(self->data);
+	free(self->sizes);
+}
+
+static size_t ct_stage_slot_size(ct_t *ct)
+{
+	size_t size = ct->size;
+	uint c;
+	for(c = 0; c < ct->columns_size; c++) size += ct->columns[c];
+	return size;
+}
+
+/* every component must belong to a distinct entity alive in the
+ * snapshot's slot table */
+static int ct_stage_check(ct_stage_t *self, const entity_slot_t *entities,
+		uint entities_size)
+{
+	char *seen = calloc(entities_size, 1);
+	uint p, j;
+
+	if(!seen && entities_size) return 0;
+	for(p = 0; p < self->pages_size; p++)
+	for(j = 0; j < self->sizes[p]; j++)
+	{
+		entity_t entity = ((c_t*)(self->data[p] + j * self->ct->size))->entity;
+		uint i = entity_index(entity);
+
+		if(i == 0 || i >= entities_size || seen[i] ||
+				entities[i].next_free != IDENT_NULL ||
+				entities[i].generation != entity_gen(entity))
+		{
+			free(seen);
+			return 0;
+		}
+		seen[i] = 1;
+	}
+	free(seen);
+	return 1;
+}
+
+static int ct_stage_read(ct_stage_t *self, FILE *fp,
+		const entity_slot_t *entities, uint entities_size)
+{
+	char name[sizeof(((ct_t*)0)->name)];
+	uint desc[4], p, c;
+	ct_t *ct;
+
+	memset(self, 0, sizeof(*self));
+	if(fread(name, sizeof(name), 1, fp) != 1) return 0;
+	name[sizeof(name) - 1] = '\0';
+
+	ct = ecm_find_ct(name);
+	if(!ct || ct->transient) return 0;
+	if(fread(desc, sizeof(desc), 1, fp) != 1) return 0;
+	if(desc[0] != ct->size || desc[1] != ct->page_size ||
+			desc[2] != ct->columns_size) return 0;
+	for(c = 0; c < desc[2]; c++)
+	{
+		uint column;
+		if(fread(&column, sizeof(column), 1, fp) != 1 ||
+				column != ct->columns[c]) return 0;
+	}
+
+	/* one component per entity at most, so a page count past that is
+	 * corrupt and must not size the allocations */
+	if(desc[3] > entities_size / ct->page_size + 1) return 0;
+
+	self->ct = ct;
+	self->sizes = calloc(desc[3], sizeof(*self->sizes));
+	self->data = calloc(desc[3], sizeof(*self->data));
+	if(desc[3] && (!self->sizes || !self->data)) return 0;
+	for(p = 0; p < desc[3]; p++)
+	{
+		uint n;
+		size_t offset;
+		if(fread(&n, sizeof(n), 1, fp) != 1 || n > ct->page_size) return 0;
+		/* pages fill in order, only the last can be partial */
+		if(p + 1 < desc[3] && n != ct->page_size) return 0;
+
+		self->sizes[p] = n;
+		self->data[p] = malloc(n * ct_stage_slot_size(ct) + 1);
+		if(!self->data[p]) return 0;
+		self->pages_size = p + 1;
+
+		if(fread(self->data[p], ct->size, n, fp) != n) return 0;
+		offset = (size_t)n * ct->size;
+		for(c = 0; c < ct->columns_size; c++)
+		{
+			if(fread(self->data[p] + offset, ct->columns[c], n, fp) != n)
+				return 0;
+			offset += (size_t)n * ct->columns[c];
+		}
+	}
+	return ct_stage_check(self, entities, entities_size);
+}
+
+/* the stage was checked by ct_stage_read, entities are valid and unique */
+static void ct_load_pages(ct_stage_t *stage)
+{
+	ct_t *self = stage->ct;
+	uint p, c, j;
+
+	SDL_LockMutex(self->mutex);
+	for(p = 0; p < stage->pages_size; p++)
+	{
+		uint n = stage->sizes[p];
+		size_t offset = (size_t)n * self->size;
+		struct comp_page *page = p < self->pages_size ? &self->pages[p]
+			: ct_add_page(self);
+
+		memcpy(page->components, stage->data[p], offset);
+		for(c = 0; c < self->columns_size; c++)
+		{
+			memcpy(page->columns[c], stage->data[p] + offset,
+					(size_t)n * self->columns[c]);
+			offset += (size_t)n * self->columns[c];
+		}
+		for(j = 0; j < n; j++)
+		{
+			c_t *comp = ct_get_at(self, p, j);
+			struct comp_index *index = ct_index_alloc(self,
+					entity_index(comp->entity));
+			ct_index_store(index, p, j * self->size);
+			page->versions[j] = g_ecm->change_tick;
+		}
+		page->version = g_ecm->change_tick;
+		page->components_size = n;
+	}
+	SDL_UnlockMutex(self->mutex);
+}
+
+int ecm_load(FILE *fp)
+{
+	uint header[3], i, j, p, cts_size, hooks_size;
+	entity_slot_t *entities;
+	ct_stage_t *stages;
+
+	if(fread(header, sizeof(header), 1, fp) != 1) return 0;
+	if(header[0] != SNAPSHOT_MAGIC || header[1] != SNAPSHOT_VERSION) return 0;
+
+	uint entities_size = header[2];
+	if(entities_size < g_ecm->entities_size) entities_size = g_ecm->entities_size;
+	entities = malloc(sizeof(*entities) * entities_size);
+	if(!entities) return 0;
+	if(fread(entities, sizeof(*entities), header[2], fp) != header[2])
+	{
+		free(entities);
+		return 0;
+	}
+
+	/* entities holding only transient components (systems, windows) are
+	 * kept, the snapshot must not have used their slots differently */
+	for(i = 1; i < g_ecm->entities_size; i++)
+	{
+		entity_slot_t *slot = &g_ecm->entities[i];
+		if(slot->next_free != IDENT_NULL) continue;
+		if(ecm_has_persistent(entity_make(i, slot->generation))) continue;
+
+		if(i < header[2] && entities[i].next_free == IDENT_NULL &&
+				entities[i].generation != slot->generation)
+		{
+			free(entities);
+			return 0;
+		}
+	}
+
+	/* read every type before anything is destroyed, a bad snapshot leaves
+	 * the world as it was */
+	if(fread(&cts_size, sizeof(cts_size), 1, fp) != 1 ||
+			cts_size > g_ecm->cts_size)
+	{
+		free(entities);
+		return 0;
+	}
+	stages = calloc(cts_size + 1, sizeof(*stages));
+	if(!stages)
+	{
+		free(entities);
+		return 0;
+	}
+	for(i = 0; i < cts_size; i++)
+	{
+		if(!ct_stage_read(&stages[i], fp, entities, header[2])) break;
+		for(j = 0; j < i; j++) if(stages[j].ct == stages[i].ct) break;
+		if(j < i) break;
+	}
+	/* the hook data can only be read into the world, make sure it is
+	 * all there first */
+	if(i < cts_size || fread(&hooks_size, sizeof(hooks_size), 1, fp) != 1 ||
+			!ecm_has_bytes(fp, hooks_size))
+	{
+		for(j = 0; j <= i && j < cts_size; j++) ct_stage_free(&stages[j]);
+		free(stages);
+		free(entities);
+		return 0;
+	}
+
+	for(i = 1; i < g_ecm->entities_size; i++)
+	{
+		entity_slot_t *slot = &g_ecm->entities[i];
+		if(slot->next_free != IDENT_NULL) continue;
+		entity_t entity = entity_make(i, slot->generation);
+		if(ecm_has_persistent(entity))
+		{
+			entity_destroy(entity);
+		}
+		else
+		{
+			entities[i] = *slot;
+		}
+	}
+	/* slots past the snapshot keep their generations */
+	for(i = header[2]; i < entities_size; i++)
+	{
+		if(g_ecm->entities[i].next_free != IDENT_NULL)
+		{
+			entities[i] = g_ecm->entities[i];
+		}
+	}
+
+	SDL_SemWait(sem);
+	free(g_ecm->entities);
+	g_ecm->entities = entities;
+	g_ecm->entities_size = g_ecm->entities_alloc = entities_size;
+	g_ecm->entities_free = 0;
+	for(i = entities_size - 1; i > 0; i--)
+	{
+		if(entities[i].next_free == IDENT_NULL) continue;
+		entities[i].next_free = g_ecm->entities_free;
+		g_ecm->entities_free = i;
+	}
+	SDL_SemPost(sem);
+
+	for(i = 0; i < cts_size; i++)
+	{
+		ct_load_pages(&stages[i]);
+	}
+	for(i = 0; i < cts_size; i++)
+	{
+		ct_t *ct = stages[i].ct;
+		ct_stage_free(&stages[i]);
+		if(!ct->load) continue;
+
+		for(p = 0; p < ct->pages_size; p++)
+		for(j = 0; j < ct->pages[p].components_size; j++)
+		{
+			ct->load(ct_get_at(ct, p, j), fp);
+		}
+	}
+	free(stages);
+	__sync_fetch_and_add(&g_ecm->version, 1);
+
+	/* rebuild the transient dependencies and let listeners set up runtime
+	 * state as if the entities had just been created */
+	for(i = 1; i < g_ecm->entities_size; i++)
+	{
+		if(g_ecm->entities[i].next_free != IDENT_NULL) continue;
+		entity_t entity = entity_make(i, g_ecm->entities[i].generation);
+		if(!ecm_has_persistent(entity)) continue;
+
+		_g_creating[_g_creating_num++] = entity;
+		for(j = 0; j < g_ecm->cts_size; j++)
+		{
+			uint d;
+			ct_t *ct = &g_ecm->cts[j];
+			if(ct->transient || !ct_get(ct, entity)) continue;
+
+			for(d = 0; d < ct->depends_size; d++)
+			{
+				if(!ct_get(ecm_get(ct->depends[d].ct), entity))
+				{
+					component_new(ct->depends[d].ct);
+				}
+			}
+		}
+		_entity_new(0);
+	}
+	return !ferror(fp);
+}
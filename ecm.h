@@ -2,11 +2,13 @@
 #define ECM_H
 
 #include <limits.h>
+#include <stdio.h>
 #include "material.h"
 #include "texture.h"
 #include "mesh.h"
 #include "entity.h"
 #include "vector.h"
+#include "arena.h"
 
 #define _GNU_SOURCE
 #include <search.h>
@@ -20,6 +22,11 @@ typedef struct c_t c_t;
 typedef void(*init_cb)(c_t *self);
 typedef int(*signal_cb)(c_t *self, void *data);
 typedef void(*c_reg_cb)(void);
+typedef void(*foreach_cb)(c_t *self, void *usrptr);
+typedef void(*snapshot_cb)(c_t *self, FILE *fp);
+/* fixes up a component copied byte for byte from a prefab, or frees what
+ * that did when a prefab's copy is dropped */
+typedef void(*clone_cb)(c_t *self);
 
 /* TODO: find appropriate place */
 typedef int(*before_draw_cb)(c_t *self);
@@ -28,12 +35,51 @@ typedef int(*before_draw_cb)(c_t *self);
 #define ENTITY 0x01
 /* #define RENDER_THREAD 0x02 */
 
+#ifdef ECM_STATS
+typedef struct
+{
+	ulong calls;
+	ulong visited; /* components the callback ran on */
+	Uint64 ticks; /* performance counter ticks */
+	Uint64 max_ticks;
+} listener_stats_t;
+#endif
+
 typedef struct
 {
 	uint signal;
 	signal_cb cb;
 	int flags;
 	uint comp_type;
+
+	/* component types the callback touches besides its own, only
+	 * listeners that declared them run concurrently */
+	int declared;
+	uint *reads;
+	uint reads_size;
+	uint *writes;
+	uint writes_size;
+
+	/* world listeners only, see ct_listener_interval, ct_listener_rate
+	 * and ct_listener_budget */
+	uint interval;
+	uint skipped;
+	Uint64 period;
+	Uint64 next_run;
+	Uint64 budget;
+	uint resume_page;
+	uint resume_slot;
+	/* time step summed over skipped emissions, see signal_set_accumulate */
+	float elapsed;
+	/* budgeted accumulating listeners: time summed over every run, and
+	 * its value when each component slot was last visited */
+	double clock;
+	double *visited_at;
+	uint visited_at_size;
+
+#ifdef ECM_STATS
+	listener_stats_t stats;
+#endif
 } listener_t;
 
 typedef struct
@@ -42,12 +88,32 @@ typedef struct
 	int is_interaction;
 } dep_t;
 
+/* default components per page, see ct_set_page_size */
 #define PAGE_SIZE 32
 
+#define SPARSE_PAGE 1024
+
+/* address space reserved for the pages of each type, see ct_set_arena */
+#define CT_ARENA_RESERVE ((size_t)256 << 20)
+
+/* one word, written whole so lock-free lookups never pair the page of one
+ * slot with the offset of another, see ct_index_load */
+struct comp_index
+{
+	uint page;
+	uint offset; /* in bytes, -1 when the entity has no component */
+} __attribute__((aligned(8)));
+
 struct comp_page
 {
 	char *components;
 	uint components_size;
+	/* change tick of the last write to each slot, see ct_write, and the
+	 * newest of them */
+	ulong *versions;
+	ulong version;
+	/* one packed array per column, see ct_set_columns */
+	char **columns;
 };
 
 typedef struct ct_t
@@ -59,24 +125,41 @@ typedef struct ct_t
 	uint id;
 	uint size;
 
-	struct {
-		uint page;
-		uint offset;
-	} *offsets;
-	uint offsets_size;
+	/* entity index to dense slot, split in pages of SPARSE_PAGE entries
+	 * allocated the first time an entity in their range is added */
+	struct comp_index **sparse;
+	uint sparse_size;
 
 	struct comp_page *pages;
 	uint pages_size;
+	uint pages_alloc;
+	uint page_size;
+	/* pages are carved back to back from here */
+	arena_t arena;
+
+	/* element size of each field stored out of the struct, by column */
+	uint *columns;
+	uint columns_size;
+
+	/* guards insertion and removal, lookups do not lock */
+	SDL_mutex *mutex;
+	void **retired;
+	uint retired_size;
 
 	dep_t *depends;
 	uint depends_size;
 
-	listener_t *listeners;
-	uint listeners_size;
-
 	int is_interaction;
 
-	/* struct hsearch_data *listeners_table; */
+	/* write and read what the raw component bytes can't carry */
+	snapshot_cb save;
+	snapshot_cb load;
+	/* runtime state, left out of snapshots. Prefabs only copy it through
+	 * a clone hook */
+	int transient;
+
+	clone_cb clone;
+	clone_cb release;
 
 	/* void *system_info; */
 	/* uint system_info_size; */
@@ -84,20 +167,58 @@ typedef struct ct_t
 
 typedef struct
 {
+	entity_t entity;
+	int broadcast; /* raised through entity_signal, not only _same */
+} signal_dirty_t;
+
+typedef struct
+{
+	char name[32];
 	uint size;
 
-	uint *cts;
-	uint cts_size;
 	listener_t *listeners;
 	uint listeners_size;
-
-	
+	uint listeners_alloc;
+
+	/* listener indices grouped in stages of non conflicting listeners,
+	 * stage i spans schedule[stages[i]] to schedule[stages[i + 1]] */
+	uint *schedule;
+	uint *stages;
+	uint stages_size;
+
+	/* coalesced signals only record the entity when raised, signals_flush
+	 * then delivers them once per entity with the entity as data */
+	int coalesce;
+	/* data is a float time step, see signal_set_accumulate */
+	int accumulate;
+	SDL_SpinLock dirty_lock;
+	signal_dirty_t *dirty;
+	uint dirty_size;
+	uint dirty_alloc;
+	signal_dirty_t *flushing;
+	uint flushing_alloc;
+	/* position in dirty + 1, by entity index */
+	uint *dirty_marks;
+	uint dirty_marks_size;
 } signal_t;
 
+typedef struct
+{
+	uint generation;
+	/* IDENT_NULL while alive, otherwise the next free slot. entity_null
+	 * is never freed so 0 ends the list */
+	uint next_free;
+} entity_slot_t;
+
 typedef struct ecm_t
 {
-	int *entities_busy;
-	uint entities_busy_size;
+	/* grown like the ct arrays, ecm_entity_alive does not lock */
+	entity_slot_t *entities;
+	uint entities_size;
+	uint entities_alloc;
+	uint entities_free;
+	void **entities_retired;
+	uint entities_retired_size;
 
 	ct_t *cts;
 	uint cts_size;
@@ -105,8 +226,19 @@ typedef struct ecm_t
 	signal_t *signals;
 	uint signals_size;
 
+	/* [ct][signal] -> listener, generated once registration is done */
+	listener_t **dispatch;
+	uint dispatch_signals;
+	uint dispatch_cts;
+
 	uint global;
 
+	/* bumped on every component add or removal */
+	ulong version;
+
+	/* stamped on component writes, see ecm_change_tick */
+	ulong change_tick;
+
 } ecm_t; /* Entity Component System */
 
 typedef struct c_t
@@ -115,6 +247,37 @@ typedef struct c_t
 	uint comp_type;
 } c_t;
 
+#define QUERY_MAX_CTS 8
+
+/* Cached list of the entities owning every component type in cts, stored
+ * as tuples of component pointers in the order the types were given. The
+ * list is rebuilt lazily by query_update after any structural change. */
+typedef struct
+{
+	uint cts[QUERY_MAX_CTS];
+	uint cts_size;
+
+	c_t **tuples;
+	uint tuples_size;
+	uint tuples_alloc;
+
+	ulong version;
+} query_t;
+
+typedef struct
+{
+	uint ct;
+	c_t *data;
+	char **columns; /* one element per column */
+} prefab_comp_t;
+
+/* Component set captured from an entity, see prefab_spawn */
+typedef struct
+{
+	prefab_comp_t *comps;
+	uint comps_size;
+} prefab_t;
+
 #define c_entity(c) (((c_t*)c)->entity)
 
 #define _type(a, b) __builtin_types_compatible_p(typeof(a), b)
@@ -135,15 +298,62 @@ static inline c_t *ct_get_at(ct_t *self, uint page, uint i)
 	return (c_t*)&(self->pages[page].components[i * self->size]);
 }
 
+static inline struct comp_index *ct_index(ct_t *self, uint i)
+{
+	uint p = i / SPARSE_PAGE;
+	if(p >= self->sparse_size || !self->sparse[p]) return NULL;
+	return &self->sparse[p][i % SPARSE_PAGE];
+}
+
+static inline struct comp_index ct_index_load(const struct comp_index *index)
+{
+	struct comp_index copy;
+	__atomic_load(index, &copy, __ATOMIC_ACQUIRE);
+	return copy;
+}
+
 static inline c_t *ct_get(ct_t *self, entity_t entity)
 {
-	if(entity >= self->offsets_size) return NULL;
-	uint offset = self->offsets[entity].offset;
-	uint page = self->offsets[entity].page;
-	if(offset == -1) return NULL;
-	return (c_t*)&(self->pages[page].components[offset]);
+	struct comp_index *at = ct_index(self, entity_index(entity));
+	if(!at) return NULL;
+	struct comp_index index = ct_index_load(at);
+	if(index.offset == -1) return NULL;
+	c_t *comp = (c_t*)&(self->pages[index.page].components[index.offset]);
+#ifdef DEBUG
+	/* stale handle, the slot has been reused by another entity */
+	if(comp->entity != entity) return NULL;
+#endif
+	return comp;
+}
+
+/* Fields moved into columns are stored per page as packed arrays instead
+ * of inside the component struct, so page-wide loops over them vectorize.
+ * They are only reachable through ct_field. */
+static inline void *ct_column(ct_t *self, uint page, uint column)
+{
+	return self->pages[page].columns[column];
+}
+
+static inline void *ct_field(ct_t *self, const c_t *comp, uint column)
+{
+	struct comp_index index = ct_index_load(
+			ct_index(self, entity_index(comp->entity)));
+	uint slot = index.offset / self->size;
+	return &self->pages[index.page].columns[column][
+		slot * self->columns[column]];
 }
 
+void ct_set_page_size(ct_t *self, uint page_size);
+/* replaces the type's page arena, huge_pages asks the system to back it
+ * with huge pages where supported */
+void ct_set_arena(ct_t *self, size_t reserve, int huge_pages);
+/* takes num element sizes as given by sizeof */
+void ct_set_columns(ct_t *self, int num, ...);
+
+uint ct_count(ct_t *self);
+/* runs cb on every component of the type, pages are split across workers */
+void ct_parallel_for(ct_t *self, foreach_cb cb, void *usrptr);
+
 void _ct_listener(ct_t *self, int flags,
 		uint signal, signal_cb cb);
 #define ct_listener(self, flags, signal, cb) \
@@ -151,14 +361,46 @@ void _ct_listener(ct_t *self, int flags,
 
 listener_t *ct_get_listener(ct_t *self, uint signal);
 
+void ct_listener_reads(ct_t *self, uint signal, int num, ...);
+void ct_listener_writes(ct_t *self, uint signal, int num, ...);
+
+/* World listeners run on every emission unless throttled. interval runs
+ * them on one emission out of interval, rate at most hz times per second
+ * of real time. For accumulating signals data is the time step summed
+ * since the listener last ran, for others it is the emission's own. With
+ * a budget in seconds each run stops once it is spent and the next one
+ * resumes at the following component, components moved around in between
+ * may be skipped or visited twice in that pass. Budgeted listeners of an
+ * accumulating signal get, per component, the time since their slot was
+ * last visited, a slot seen for the first time gets the current run's. */
+void ct_listener_interval(ct_t *self, uint signal, uint interval);
+void ct_listener_rate(ct_t *self, uint signal, float hz);
+void ct_listener_budget(ct_t *self, uint signal, float seconds);
+void signal_build_schedule(signal_t *self);
+
 /* void ct_register_callback(ct_t *self, uint callback, void *cb); */
 
 c_t *ct_add(ct_t *self, entity_t entity);
+void ct_remove(ct_t *self, entity_t entity);
 
 extern ecm_t *g_ecm;
 void ecm_init(void);
 entity_t ecm_new_entity(void);
-void signal_init(uint *target, uint size);
+void ecm_new_entities(uint count, entity_t *out);
+void ecm_free_entity(entity_t entity);
+int ecm_entity_alive(entity_t entity);
+entity_t ecm_entity_at(uint index);
+void _signal_init(uint *target, uint size, const char *name);
+#define signal_init(target, size) (_signal_init(target, size, #target))
+/* emissions only mark the entity, signals_flush then delivers each marked
+ * entity once with &entity as data, whatever data was raised with, so
+ * listeners must not read it as anything else. Flushes run on the ticker
+ * at the end of a tick. */
+void signal_set_coalesce(uint signal, int coalesce);
+/* the signal's data is a float time step, listeners throttled with
+ * ct_listener_interval or ct_listener_rate get the sum over the emissions
+ * they skipped instead of the last one */
+void signal_set_accumulate(uint signal, int accumulate);
 
 void ecm_add_entity(entity_t *entity);
 /* uint ecm_register_system(ecm_t *self, void *system); */
@@ -166,16 +408,91 @@ void ecm_add_entity(entity_t *entity);
 ct_t *ct_new(const char *name, uint *target, uint size,
 		init_cb init, int depend_size, ...);
 
+void ct_set_snapshot(ct_t *self, snapshot_cb save, snapshot_cb load);
+void ct_set_transient(ct_t *self);
+
+/* Snapshots hold the entity allocator and the pages of every persistent
+ * type. Loading replaces every entity owning persistent components and
+ * keeps the rest, then raises entity_created for the loaded entities.
+ * Both must run between ticks on seekable files, they return 0 on
+ * failure. A snapshot that is truncated, doesn't match the registered
+ * types, or has components on dead, repeated or out of range entities is
+ * rejected before the world is touched. What save hooks wrote is only
+ * checked to be all there, the load hooks parse it. */
+int ecm_save(FILE *fp);
+int ecm_load(FILE *fp);
+
+void ct_set_clone(ct_t *self, clone_cb clone, clone_cb release);
+
+/* Captures the components of source as they are now. Spawning copies them
+ * into count new entities, written to out, without running constructors:
+ * each type's clone hook fixes up the copy. Transient types have no state
+ * worth copying but init alone may not rebuild it either, so a source with
+ * a transient type that has no clone hook is refused with NULL.
+ * entity_created is raised per listener over the whole batch, not per
+ * entity. */
+prefab_t *prefab_new(entity_t source);
+void prefab_spawn(prefab_t *self, uint count, entity_t *out);
+void prefab_destroy(prefab_t *self);
+
 void ct_add_dependency(ct_t *ct, ct_t *dep);
 void ct_add_interaction(ct_t *ct, ct_t *dep);
 
 static inline ct_t *ecm_get(uint comp_type) {
 	return &g_ecm->cts[comp_type]; }
-/* void ecm_generate_hashes(ecm_t *self); */
+
+/* Marks comp as changed and returns it, writes that should show up in
+ * query_update_changed go through it. */
+static inline void *ct_write(ct_t *self, void *comp)
+{
+	struct comp_index index = ct_index_load(
+			ct_index(self, entity_index(c_entity(comp))));
+	struct comp_page *page = &self->pages[index.page];
+	ulong tick = g_ecm->change_tick;
+	page->versions[index.offset / self->size] = tick;
+	page->version = tick;
+	return comp;
+}
+
+/* change tick of the last write to comp */
+static inline ulong ct_version(ct_t *self, const void *comp)
+{
+	struct comp_index index = ct_index_load(
+			ct_index(self, entity_index(c_entity(comp))));
+	return self->pages[index.page].versions[index.offset / self->size];
+}
+
+/* Returns the current change tick and advances it. A system keeps the
+ * value from its previous run and passes it as since, so it sees every
+ * write made after that run started. */
+ulong ecm_change_tick(void);
+void ecm_generate_dispatch(void);
 
 void *component_new(int comp_type);
 
+query_t *query_new(int cts_size, ...);
+uint query_update(query_t *self);
+/* Matches only the entities whose component of type cts[filter] was
+ * added or written after since. Never cached, pages without newer writes
+ * are skipped whole. */
+uint query_update_changed(query_t *self, uint filter, ulong since);
+void query_destroy(query_t *self);
+
+static inline c_t **query_at(query_t *self, uint i)
+{
+	return &self->tuples[i * self->cts_size];
+}
+
+#ifdef ECM_STATS
+void listener_stats_add(listener_t *self, Uint64 start, uint visited);
+listener_stats_t *ecm_stats_get(uint signal, uint comp_type);
+void ecm_stats_reset(void);
+/* writes one CSV row per listener, returns 0 if the file can't be opened */
+int ecm_stats_dump(const char *filename);
+#endif
+
 /* builtin signals */
 extern uint entity_created;
+extern uint entity_destroyed;
 
 #endif /* !ECM_H */
@@ -1,6 +1,9 @@
 #include "entity.h"
 #include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
 #include <ecm.h>
+#include <jobs.h>
 #include <candle.h>
 #include <components/name.h>
 
@@ -74,56 +77,293 @@ entity_t _entity_new(int comp_num, ...)
 /* 	} */
 /* } */
 
+#ifdef ECM_STATS
+#define STATS_BEGIN() Uint64 stats_start = SDL_GetPerformanceCounter()
+#define STATS_END(listener, visited) \
+	listener_stats_add(listener, stats_start, visited)
+#else
+#define STATS_BEGIN()
+#define STATS_END(listener, visited)
+#endif
+
+int listener_signal_same(listener_t *self, entity_t ent, void *data)
+{
+	c_t *comp = ct_get(ecm_get(self->comp_type), ent);
+	if(comp)
+	{
+		STATS_BEGIN();
+		int res = self->cb(comp, data);
+		STATS_END(self, 1);
+		return res;
+	}
+	return 1;
+}
+
+static int listener_due(listener_t *self)
+{
+	if(self->interval > 1)
+	{
+		if(++self->skipped < self->interval) return 0;
+		self->skipped = 0;
+	}
+	if(self->period)
+	{
+		Uint64 now = SDL_GetPerformanceCounter();
+		if(now < self->next_run) return 0;
+		self->next_run += self->period;
+		/* fell behind, don't run back to back to catch up */
+		if(self->next_run < now) self->next_run = now + self->period;
+	}
+	return 1;
+}
+
+/* time since slot k was last visited, slots not seen yet count from the
+ * start of this run */
+static float listener_slot_step(listener_t *self, uint k, double start)
+{
+	float step;
+	if(k >= self->visited_at_size)
+	{
+		uint i, size = self->visited_at_size ? self->visited_at_size : 64;
+		while(size <= k) size *= 2;
+		self->visited_at = realloc(self->visited_at,
+				sizeof(*self->visited_at) * size);
+		for(i = self->visited_at_size; i < size; i++)
+			self->visited_at[i] = start;
+		self->visited_at_size = size;
+	}
+	step = self->clock - self->visited_at[k];
+	self->visited_at[k] = self->clock;
+	return step;
+}
+
+/* runs from where the last slice stopped until the budget is spent. A
+ * slice only reaches part of the components, so an accumulated step is
+ * handed out per component instead of whole to whichever run */
+static int listener_signal_slice(listener_t *self, ct_t *ct, void *data,
+		int accumulate, uint *visited)
+{
+	int res = 1;
+	uint p = self->resume_page, j = self->resume_slot;
+	Uint64 end = SDL_GetPerformanceCounter() + self->budget;
+	double start = self->clock;
+	float step;
+
+	if(accumulate)
+	{
+		self->clock += *(float*)data;
+		data = &step;
+	}
+	if(p >= ct->pages_size) p = j = 0;
+	for(; p < ct->pages_size; p++, j = 0)
+	{
+		for(; j < ct->pages[p].components_size; j++)
+		{
+			c_t *c = ct_get_at(ct, p, j);
+			(*visited)++;
+			if(accumulate)
+			{
+				step = listener_slot_step(self, p * ct->page_size + j, start);
+			}
+			res = self->cb(c, data);
+			if(res == 0 || SDL_GetPerformanceCounter() >= end)
+			{
+				self->resume_page = p;
+				self->resume_slot = j + 1;
+				return res;
+			}
+		}
+	}
+	self->resume_page = self->resume_slot = 0;
+	return res;
+}
+
 int listener_signal(listener_t *self, entity_t ent, void *data)
 {
-	int p, j;
+	int p, j, res = 1;
+	uint visited = 0;
+	float elapsed;
+	int accumulate;
+
+	/* an entity owns at most one component per type, resolve it directly
+	 * instead of walking every page of the listening type */
+	if(self->flags & ENTITY) return listener_signal_same(self, ent, data);
+
+	accumulate = data && g_ecm->signals[self->signal].accumulate;
+	if(accumulate)
+	{
+		/* throttled listeners advance by all the time they sat out */
+		self->elapsed += *(float*)data;
+		if(!listener_due(self)) return 1;
+		elapsed = self->elapsed;
+		self->elapsed = 0.0f;
+		data = &elapsed;
+	}
+	else if(!listener_due(self)) return 1;
+
+	STATS_BEGIN();
 	ct_t *ct = ecm_get(self->comp_type);
-	for(p = 0; p < ct->pages_size; p++)
+	if(self->budget)
+	{
+		res = listener_signal_slice(self, ct, data, accumulate, &visited);
+	}
+	else for(p = 0; p < ct->pages_size && res; p++)
 	{
 		for(j = 0; j < ct->pages[p].components_size; j++)
 		{
 			c_t *c = ct_get_at(ct, p, j);
-			if((self->flags & ENTITY) && c_entity(c) != ent)
-				continue;
+			visited++;
+			if((res = self->cb(c, data)) == 0) break;
+		}
+	}
+	STATS_END(self, visited);
+	return res;
+}
 
-			if(self->cb(c, data) == 0) return 0;
+int component_signal(c_t *comp, ct_t *ct, uint signal, void *data)
+{
+	listener_t *listener = ct_get_listener(ct, signal);
+	if(listener)
+	{
+		STATS_BEGIN();
+		listener->cb(comp, data);
+		STATS_END(listener, 1);
+	}
+	return 1;
+}
+
+static int signal_coalesce(signal_t *sig, entity_t entity, int broadcast)
+{
+	uint i = entity_index(entity);
+
+	SDL_AtomicLock(&sig->dirty_lock);
+	if(i >= sig->dirty_marks_size)
+	{
+		uint new_size = sig->dirty_marks_size ? sig->dirty_marks_size : 1024;
+		while(new_size <= i) new_size *= 2;
+		sig->dirty_marks = realloc(sig->dirty_marks,
+				sizeof(*sig->dirty_marks) * new_size);
+		memset(&sig->dirty_marks[sig->dirty_marks_size], 0,
+				sizeof(*sig->dirty_marks) * (new_size - sig->dirty_marks_size));
+		sig->dirty_marks_size = new_size;
+	}
+
+	uint mark = sig->dirty_marks[i];
+	if(mark && sig->dirty[mark - 1].entity == entity)
+	{
+		sig->dirty[mark - 1].broadcast |= broadcast;
+	}
+	else
+	{
+		if(sig->dirty_size == sig->dirty_alloc)
+		{
+			sig->dirty_alloc = sig->dirty_alloc ? sig->dirty_alloc * 2 : 64;
+			sig->dirty = realloc(sig->dirty, sizeof(*sig->dirty) *
+					sig->dirty_alloc);
 		}
+		sig->dirty[sig->dirty_size++] = (signal_dirty_t){entity, broadcast};
+		sig->dirty_marks[i] = sig->dirty_size;
 	}
+	SDL_AtomicUnlock(&sig->dirty_lock);
 	return 1;
 }
 
-int listener_signal_same(listener_t *self, entity_t ent, void *data)
+static int signal_emit_same(signal_t *sig, entity_t self, void *data)
 {
-	c_t *comp = ct_get(ecm_get(self->comp_type), ent);
-	if(comp)
+	uint i;
+	for(i = 0; i < sig->listeners_size; i++)
 	{
-		return self->cb(comp, data);
+		listener_t *lis = &sig->listeners[i];
+		int res = listener_signal_same(lis, self, data);
+		if(res == 0) return 0;
 	}
 	return 1;
 }
 
-int component_signal(c_t *comp, ct_t *ct, uint signal, void *data)
+static int signal_emit(signal_t *sig, entity_t self, void *data)
 {
-	listener_t *listener = ct_get_listener(ct, signal);
-	if(listener)
+	uint i;
+	for(i = 0; i < sig->listeners_size; i++)
 	{
-		listener->cb(comp, data);
+		listener_t *lis = &sig->listeners[i];
+		if(listener_signal(lis, self, data) == 0) return 0;
 	}
 	return 1;
 }
 
+void signals_flush()
+{
+	uint s, i;
+
+	for(s = 0; s < g_ecm->signals_size; s++)
+	{
+		signal_t *sig = &g_ecm->signals[s];
+		if(!sig->coalesce) continue;
+
+		/* swap lists so listeners can raise the signal again, those
+		 * emissions are delivered on the next flush */
+		SDL_AtomicLock(&sig->dirty_lock);
+		signal_dirty_t *flushing = sig->dirty;
+		uint flushing_alloc = sig->dirty_alloc;
+		uint flushing_size = sig->dirty_size;
+		sig->dirty = sig->flushing;
+		sig->dirty_alloc = sig->flushing_alloc;
+		sig->dirty_size = 0;
+		sig->flushing = flushing;
+		sig->flushing_alloc = flushing_alloc;
+		for(i = 0; i < flushing_size; i++)
+		{
+			sig->dirty_marks[entity_index(flushing[i].entity)] = 0;
+		}
+		SDL_AtomicUnlock(&sig->dirty_lock);
+
+		for(i = 0; i < flushing_size; i++)
+		{
+			signal_dirty_t *dirty = &flushing[i];
+			if(!ecm_entity_alive(dirty->entity)) continue;
+
+			if(dirty->broadcast)
+			{
+				signal_emit(sig, dirty->entity, &dirty->entity);
+			}
+			else
+			{
+				signal_emit_same(sig, dirty->entity, &dirty->entity);
+			}
+		}
+	}
+}
+
 int entity_signal_same(entity_t self, uint signal, void *data)
 {
 	/* if(signal == IDENT_NULL) exit(1); */
-	uint i;
+	signal_t *sig = &g_ecm->signals[signal];
 
+	if(sig->coalesce) return signal_coalesce(sig, self, 0);
+	return signal_emit_same(sig, self, data);
+}
+
+/* Same as raising the signal with entity_signal_same on every entity, but
+ * each listener runs over the whole batch before the next one starts. A
+ * listener returning 0 does not stop propagation. */
+int entity_signal_same_batch(const entity_t *entities, uint count,
+		uint signal, void *data)
+{
+	uint i, j;
 	signal_t *sig = &g_ecm->signals[signal];
 
+	if(sig->coalesce)
+	{
+		for(j = 0; j < count; j++) signal_coalesce(sig, entities[j], 0);
+		return 1;
+	}
 	for(i = 0; i < sig->listeners_size; i++)
 	{
 		listener_t *lis = &sig->listeners[i];
-		int res = listener_signal_same(lis, self, data);
-		if(res == 0) return 0;
+		for(j = 0; j < count; j++)
+		{
+			listener_signal_same(lis, entities[j], data);
+		}
 	}
 	return 1;
 }
@@ -161,20 +401,69 @@ int entity_signal_same(entity_t self, uint signal, void *data)
 
 int entity_signal(entity_t self, uint signal, void *data)
 {
-	uint i;
 	/* if(signal == IDENT_NULL) exit(1); */
+	signal_t *sig = &g_ecm->signals[signal];
+
+	if(sig->coalesce) return signal_coalesce(sig, self, 1);
+	return signal_emit(sig, self, data);
+}
+
+typedef struct
+{
+	listener_t *listener;
+	entity_t entity;
+	void *data;
+} listener_job_t;
+
+static void listener_job(listener_job_t *self)
+{
+	listener_signal(self->listener, self->entity, self->data);
+}
+
+/* Like entity_signal, but listeners with declared, non conflicting component
+ * access run concurrently on the job workers. A listener returning 0 does not
+ * stop propagation. */
+int entity_signal_parallel(entity_t self, uint signal, void *data)
+{
+	uint s, i;
 
 	signal_t *sig = &g_ecm->signals[signal];
-	for(i = 0; i < sig->listeners_size; i++)
+	if(!sig->schedule) signal_build_schedule(sig);
+
+	for(s = 0; s < sig->stages_size; s++)
 	{
-		listener_t *lis = &sig->listeners[i];
-		if(listener_signal(lis, self, data) == 0) return 0;
+		uint start = sig->stages[s];
+		uint end = sig->stages[s + 1];
+		listener_job_t jobs[end - start];
+		job_counter_t counter = {{0}};
+
+		for(i = start; i < end; i++)
+		{
+			listener_job_t *job = &jobs[i - start];
+			*job = (listener_job_t){&sig->listeners[sig->schedule[i]], self, data};
+
+			/* the last listener of the stage runs on this thread */
+			if(i + 1 < end) jobs_push((job_cb)listener_job, job, &counter);
+			else listener_job(job);
+		}
+		jobs_wait(&counter);
 	}
 	return 1;
 }
 
-void entity_destroy(entity_t self) 
+void entity_destroy(entity_t self)
 {
+	int i;
+	if(self == entity_null) return;
+	if(!ecm_entity_alive(self)) return;
+
+	/* dependencies are always registered before their dependents, remove in
+	 * reverse so dependents can still reach them on entity_destroyed */
+	for(i = g_ecm->cts_size - 1; i >= 0; i--)
+	{
+		ct_remove(&g_ecm->cts[i], self);
+	}
+	ecm_free_entity(self);
 }
 
 
@@ -5,11 +5,17 @@
 typedef struct c_t c_t;
 typedef struct ct_t ct_t;
 
-typedef unsigned long entity_t;
+/* low 32 bits index the entity slot, high 32 bits hold the generation of
+ * that slot so handles to destroyed entities can be told apart */
+typedef unsigned long long entity_t;
 
 typedef int(*filter_cb)(c_t *self, c_t *accepted, void *data);
 #define entity_null ((entity_t)0)
 
+#define entity_index(e) ((unsigned int)((e) & 0xFFFFFFFF))
+#define entity_gen(e) ((unsigned int)((e) >> 32))
+#define entity_make(index, gen) (((entity_t)(gen) << 32) | (entity_t)(index))
+
 extern __thread entity_t _g_creating[32];
 extern __thread int _g_creating_num;
 
@@ -22,8 +28,13 @@ int entity_signal_same_TOPLEVEL(entity_t self, unsigned int signal, void *data);
 int entity_signal_TOPLEVEL(entity_t self, unsigned int signal, void *data);
 int component_signal_TOPLEVEL(c_t *comp, ct_t *ct, unsigned int signal, void *data);
 int entity_signal_same(entity_t self, unsigned int signal, void *data);
+int entity_signal_same_batch(const entity_t *entities, unsigned int count,
+		unsigned int signal, void *data);
 int entity_signal(entity_t self, unsigned int signal, void *data);
+int entity_signal_parallel(entity_t self, unsigned int signal, void *data);
 int component_signal(c_t *comp, ct_t *ct, unsigned int signal, void *data);
+/* delivers the pending emissions of coalesced signals */
+void signals_flush(void);
 
 void entity_filter(entity_t self, unsigned int signal, void *data,
 		filter_cb cb, c_t *c_caller, void *cb_data);
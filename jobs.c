@@ -0,0 +1,239 @@
+#include "jobs.h"
+#include <stdlib.h>
+
+typedef struct
+{
+	job_cb cb;
+	void *usrptr;
+	job_counter_t *counter;
+} job_t;
+
+/* Owners push and pop at the bottom, thieves take from the top */
+typedef struct
+{
+	SDL_SpinLock lock;
+	job_t *jobs;
+	uint alloc; /* power of two */
+	uint top;
+	uint bottom;
+} deque_t;
+
+static struct
+{
+	/* one deque per worker plus a shared one for every other thread */
+	deque_t *deques;
+	int workers_num;
+
+	SDL_atomic_t queued;
+	SDL_atomic_t sleeping;
+	SDL_mutex *mutex;
+	SDL_cond *cond;
+} g_jobs;
+
+static __thread int g_worker_id = -1;
+
+static deque_t *jobs_own_deque(void)
+{
+	return &g_jobs.deques[g_worker_id >= 0 ? g_worker_id : g_jobs.workers_num];
+}
+
+static void deque_push(deque_t *self, job_t *job)
+{
+	SDL_AtomicLock(&self->lock);
+	if(self->bottom - self->top == self->alloc)
+	{
+		uint i, alloc = self->alloc * 2;
+		job_t *jobs = malloc(sizeof(*jobs) * alloc);
+		for(i = self->top; i != self->bottom; i++)
+		{
+			jobs[i & (alloc - 1)] = self->jobs[i & (self->alloc - 1)];
+		}
+		free(self->jobs);
+		self->jobs = jobs;
+		self->alloc = alloc;
+	}
+	self->jobs[self->bottom++ & (self->alloc - 1)] = *job;
+	SDL_AtomicUnlock(&self->lock);
+}
+
+static int deque_pop(deque_t *self, job_t *job)
+{
+	int found = 0;
+	SDL_AtomicLock(&self->lock);
+	if(self->bottom != self->top)
+	{
+		*job = self->jobs[--self->bottom & (self->alloc - 1)];
+		found = 1;
+	}
+	SDL_AtomicUnlock(&self->lock);
+	return found;
+}
+
+static int deque_steal(deque_t *self, job_t *job)
+{
+	int found = 0;
+	SDL_AtomicLock(&self->lock);
+	if(self->bottom != self->top)
+	{
+		*job = self->jobs[self->top++ & (self->alloc - 1)];
+		found = 1;
+	}
+	SDL_AtomicUnlock(&self->lock);
+	return found;
+}
+
+static int jobs_find(job_t *job)
+{
+	int i;
+	deque_t *own = jobs_own_deque();
+	if(deque_pop(own, job)) goto found;
+
+	int start = g_worker_id + 1;
+	for(i = 0; i <= g_jobs.workers_num; i++)
+	{
+		deque_t *victim = &g_jobs.deques[(start + i) % (g_jobs.workers_num + 1)];
+		if(victim != own && deque_steal(victim, job)) goto found;
+	}
+	return 0;
+
+found:
+	SDL_AtomicAdd(&g_jobs.queued, -1);
+	return 1;
+}
+
+static void job_run(job_t *job)
+{
+	job->cb(job->usrptr);
+	if(job->counter) SDL_AtomicAdd(&job->counter->pending, -1);
+}
+
+static int jobs_worker_loop(void *usrptr)
+{
+	job_t job;
+	g_worker_id = (int)(size_t)usrptr;
+	while(1)
+	{
+		if(jobs_find(&job))
+		{
+			job_run(&job);
+			continue;
+		}
+
+		/* pushers check sleeping after bumping queued, so either they see
+		 * us here or we see their job below */
+		SDL_LockMutex(g_jobs.mutex);
+		SDL_AtomicAdd(&g_jobs.sleeping, 1);
+		while(!SDL_AtomicGet(&g_jobs.queued))
+		{
+			SDL_CondWait(g_jobs.cond, g_jobs.mutex);
+		}
+		SDL_AtomicAdd(&g_jobs.sleeping, -1);
+		SDL_UnlockMutex(g_jobs.mutex);
+	}
+	return 1;
+}
+
+void jobs_init(int workers_num)
+{
+	int i;
+	if(g_jobs.deques) return;
+
+	if(workers_num < 0) workers_num = SDL_GetCPUCount() - 1;
+
+	g_jobs.mutex = SDL_CreateMutex();
+	g_jobs.cond = SDL_CreateCond();
+	g_jobs.deques = calloc(workers_num + 1, sizeof(*g_jobs.deques));
+	for(i = 0; i <= workers_num; i++)
+	{
+		g_jobs.deques[i].alloc = 64;
+		g_jobs.deques[i].jobs = malloc(sizeof(job_t) * g_jobs.deques[i].alloc);
+	}
+	g_jobs.workers_num = workers_num;
+
+	for(i = 0; i < workers_num; i++)
+	{
+		SDL_DetachThread(SDL_CreateThread(jobs_worker_loop, "job_worker",
+					(void*)(size_t)i));
+	}
+}
+
+int jobs_workers()
+{
+	return g_jobs.workers_num;
+}
+
+void jobs_push(job_cb cb, void *usrptr, job_counter_t *counter)
+{
+	job_t job = {.cb = cb, .usrptr = usrptr, .counter = counter};
+	if(counter) SDL_AtomicAdd(&counter->pending, 1);
+
+	if(!g_jobs.workers_num)
+	{
+		job_run(&job);
+		return;
+	}
+
+	deque_push(jobs_own_deque(), &job);
+	SDL_AtomicAdd(&g_jobs.queued, 1);
+
+	if(SDL_AtomicGet(&g_jobs.sleeping))
+	{
+		SDL_LockMutex(g_jobs.mutex);
+		SDL_CondSignal(g_jobs.cond);
+		SDL_UnlockMutex(g_jobs.mutex);
+	}
+}
+
+void jobs_wait(job_counter_t *counter)
+{
+	job_t job;
+	/* help with queued work instead of blocking */
+	while(SDL_AtomicGet(&counter->pending) > 0)
+	{
+		if(jobs_find(&job)) job_run(&job);
+		else SDL_Delay(0);
+	}
+}
+
+typedef struct
+{
+	range_cb cb;
+	void *usrptr;
+	uint start;
+	uint end;
+} range_job_t;
+
+static void range_job(range_job_t *self)
+{
+	self->cb(self->usrptr, self->start, self->end);
+}
+
+void jobs_parallel_for(uint count, uint grain, range_cb cb, void *usrptr)
+{
+	uint i;
+	if(!count) return;
+
+	/* a few chunks per worker leaves room for stealing to balance */
+	uint chunk = count / ((g_jobs.workers_num + 1) * 4);
+	if(chunk < grain) chunk = grain;
+	if(chunk < 1) chunk = 1;
+
+	uint chunks = (count + chunk - 1) / chunk;
+	if(chunks == 1)
+	{
+		cb(usrptr, 0, count);
+		return;
+	}
+
+	range_job_t *ranges = malloc(sizeof(*ranges) * chunks);
+	job_counter_t counter = {{0}};
+
+	for(i = 0; i < chunks; i++)
+	{
+		uint end = (i + 1) * chunk;
+		ranges[i] = (range_job_t){cb, usrptr, i * chunk, end > count ? count : end};
+		jobs_push((job_cb)range_job, &ranges[i], &counter);
+	}
+	jobs_wait(&counter);
+	free(ranges);
+}
@@ -0,0 +1,24 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <SDL2/SDL.h>
+
+typedef void(*job_cb)(void *usrptr);
+typedef void(*range_cb)(void *usrptr, unsigned int start, unsigned int end);
+
+/* Tracks a group of jobs, jobs_wait returns once all of them are done */
+typedef struct
+{
+	SDL_atomic_t pending;
+} job_counter_t;
+
+void jobs_init(int workers_num);
+int jobs_workers(void);
+void jobs_push(job_cb cb, void *usrptr, job_counter_t *counter);
+void jobs_wait(job_counter_t *counter);
+
+/* splits [0, count) in chunks of at least grain and waits for all of them */
+void jobs_parallel_for(unsigned int count, unsigned int grain, range_cb cb,
+		void *usrptr);
+
+#endif /* !JOBS_H */
@@ -11,8 +11,10 @@ loader_t *loader_new()
 	return self;
 }
 
+/* headless instances have no loader, GL work is dropped on the floor */
 void loader_push_wait(loader_t *self, loader_cb cb, void *usrptr, c_t *c)
 {
+	if(!self) return;
 	if(SDL_ThreadID() == self->threadId)
 	{
 		if(usrptr)
@@ -45,6 +47,7 @@ void loader_push_wait(loader_t *self, loader_cb cb, void *usrptr, c_t *c)
 
 void loader_push(loader_t *self, loader_cb cb, void *usrptr, c_t *c)
 {
+	if(!self) return;
 	int same_thread = SDL_ThreadID() == self->threadId;
 	if(!same_thread) SDL_SemWait(self->semaphore);
 		load_t *load = &self->stack[self->last];
@@ -99,6 +102,7 @@ void loader_destroy(loader_t *self)
 
 void loader_wait(loader_t *self)
 {
+	if(!self) return;
 	while(self->last != self->first)
 	{
 		/* printf("%d %d\n", self->last, self->first); */
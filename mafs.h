@@ -15,6 +15,24 @@
 #define CONST __constant
 #endif
 
+/* mat4_mul, mat4_mul_vec4, mat4_invert and mat4_from_quat have SIMD
+ * versions picked at compile time, the scalar ones stay as *_scalar for
+ * reference and OpenCL. MAFS_NO_SIMD forces the scalar ones everywhere. */
+#if !defined(__OPENCL_C_VERSION__) && !defined(MAFS_NO_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MAFS_SSE
+#include <emmintrin.h>
+#ifdef __AVX__
+#define MAFS_AVX
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MAFS_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
 #define n_t float
 
 #define MAFS_DEFINE_STRUCTS(n_t, type) \
@@ -512,7 +530,7 @@ static inline void mat4_print(mat4_t M)
 	printf("%f	%f	%f	%f\n", M._[2].x, M._[2].y, M._[2].z, M._[2].w);
 	printf("%f	%f	%f	%f\n", M._[3].x, M._[3].y, M._[3].z, M._[3].w);
 }
-static inline mat4_t mat4_mul(mat4_t a, mat4_t b)
+static inline mat4_t mat4_mul_scalar(mat4_t a, mat4_t b)
 {
 	mat4_t M;
 	int k, r, c;
@@ -523,7 +541,7 @@ static inline mat4_t mat4_mul(mat4_t a, mat4_t b)
 	}
 	return M;
 }
-static inline vec4_t mat4_mul_vec4(mat4_t M, vec4_t v)
+static inline vec4_t mat4_mul_vec4_scalar(mat4_t M, vec4_t v)
 {
 	vec4_t r;
 	int i, j;
@@ -534,6 +552,215 @@ static inline vec4_t mat4_mul_vec4(mat4_t M, vec4_t v)
 	}
 	return r;
 }
+/* columns of the result are the columns of a weighted by b's */
+static inline mat4_t mat4_mul(mat4_t a, mat4_t b)
+{
+#if defined(MAFS_AVX)
+	mat4_t M;
+	int c;
+	__m256 a0 = _mm256_broadcast_ps((const __m128*)a._[0]._);
+	__m256 a1 = _mm256_broadcast_ps((const __m128*)a._[1]._);
+	__m256 a2 = _mm256_broadcast_ps((const __m128*)a._[2]._);
+	__m256 a3 = _mm256_broadcast_ps((const __m128*)a._[3]._);
+	for(c=0; c<4; c+=2) {
+		__m256 bc = _mm256_loadu_ps(b._[c]._);
+		__m256 r = _mm256_mul_ps(a0, _mm256_permute_ps(bc, 0x00));
+		r = _mm256_add_ps(r, _mm256_mul_ps(a1, _mm256_permute_ps(bc, 0x55)));
+		r = _mm256_add_ps(r, _mm256_mul_ps(a2, _mm256_permute_ps(bc, 0xAA)));
+		r = _mm256_add_ps(r, _mm256_mul_ps(a3, _mm256_permute_ps(bc, 0xFF)));
+		_mm256_storeu_ps(M._[c]._, r);
+	}
+	return M;
+#elif defined(MAFS_SSE)
+	mat4_t M;
+	int c;
+	__m128 a0 = _mm_loadu_ps(a._[0]._);
+	__m128 a1 = _mm_loadu_ps(a._[1]._);
+	__m128 a2 = _mm_loadu_ps(a._[2]._);
+	__m128 a3 = _mm_loadu_ps(a._[3]._);
+	for(c=0; c<4; ++c) {
+		__m128 r = _mm_mul_ps(a0, _mm_set1_ps(b._[c]._[0]));
+		r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(b._[c]._[1])));
+		r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(b._[c]._[2])));
+		r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(b._[c]._[3])));
+		_mm_storeu_ps(M._[c]._, r);
+	}
+	return M;
+#elif defined(MAFS_NEON)
+	mat4_t M;
+	int c;
+	float32x4_t a0 = vld1q_f32(a._[0]._);
+	float32x4_t a1 = vld1q_f32(a._[1]._);
+	float32x4_t a2 = vld1q_f32(a._[2]._);
+	float32x4_t a3 = vld1q_f32(a._[3]._);
+	for(c=0; c<4; ++c) {
+		float32x4_t r = vmulq_n_f32(a0, b._[c]._[0]);
+		r = vmlaq_n_f32(r, a1, b._[c]._[1]);
+		r = vmlaq_n_f32(r, a2, b._[c]._[2]);
+		r = vmlaq_n_f32(r, a3, b._[c]._[3]);
+		vst1q_f32(M._[c]._, r);
+	}
+	return M;
+#else
+	return mat4_mul_scalar(a, b);
+#endif
+}
+static inline vec4_t mat4_mul_vec4(mat4_t M, vec4_t v)
+{
+#if defined(MAFS_SSE)
+	vec4_t r;
+	__m128 s = _mm_mul_ps(_mm_loadu_ps(M._[0]._), _mm_set1_ps(v._[0]));
+	s = _mm_add_ps(s, _mm_mul_ps(_mm_loadu_ps(M._[1]._), _mm_set1_ps(v._[1])));
+	s = _mm_add_ps(s, _mm_mul_ps(_mm_loadu_ps(M._[2]._), _mm_set1_ps(v._[2])));
+	s = _mm_add_ps(s, _mm_mul_ps(_mm_loadu_ps(M._[3]._), _mm_set1_ps(v._[3])));
+	_mm_storeu_ps(r._, s);
+	return r;
+#elif defined(MAFS_NEON)
+	vec4_t r;
+	float32x4_t s = vmulq_n_f32(vld1q_f32(M._[0]._), v._[0]);
+	s = vmlaq_n_f32(s, vld1q_f32(M._[1]._), v._[1]);
+	s = vmlaq_n_f32(s, vld1q_f32(M._[2]._), v._[2]);
+	s = vmlaq_n_f32(s, vld1q_f32(M._[3]._), v._[3]);
+	vst1q_f32(r._, s);
+	return r;
+#else
+	return mat4_mul_vec4_scalar(M, v);
+#endif
+}
+
+#ifndef __OPENCL_C_VERSION__
+/* Transforms count vec3s taken as (x, y, z, w) by M. Strides are in bytes
+ * so positions can be walked inside larger structs, in and out may be the
+ * same memory. */
+static inline void mat4_mul_vec3_strided(mat4_t M, vec3_t *out,
+		size_t out_stride, const vec3_t *in, size_t in_stride, int count,
+		n_t w)
+{
+	int i;
+#if defined(MAFS_SSE)
+	__m128 c0 = _mm_loadu_ps(M._[0]._);
+	__m128 c1 = _mm_loadu_ps(M._[1]._);
+	__m128 c2 = _mm_loadu_ps(M._[2]._);
+	__m128 c3 = _mm_mul_ps(_mm_loadu_ps(M._[3]._), _mm_set1_ps(w));
+	for(i = 0; i < count; i++)
+	{
+		const n_t *p = (const n_t*)((const char*)in + i * in_stride);
+		n_t *o = (n_t*)((char*)out + i * out_stride);
+		__m128 r = _mm_add_ps(c3, _mm_mul_ps(c0, _mm_set1_ps(p[0])));
+		r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(p[1])));
+		r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(p[2])));
+		_mm_storel_pi((__m64*)o, r);
+		_mm_store_ss(o + 2, _mm_movehl_ps(r, r));
+	}
+#elif defined(MAFS_NEON)
+	float32x4_t c0 = vld1q_f32(M._[0]._);
+	float32x4_t c1 = vld1q_f32(M._[1]._);
+	float32x4_t c2 = vld1q_f32(M._[2]._);
+	float32x4_t c3 = vmulq_n_f32(vld1q_f32(M._[3]._), w);
+	for(i = 0; i < count; i++)
+	{
+		const n_t *p = (const n_t*)((const char*)in + i * in_stride);
+		n_t *o = (n_t*)((char*)out + i * out_stride);
+		float32x4_t r = vmlaq_n_f32(c3, c0, p[0]);
+		r = vmlaq_n_f32(r, c1, p[1]);
+		r = vmlaq_n_f32(r, c2, p[2]);
+		vst1_f32(o, vget_low_f32(r));
+		vst1q_lane_f32(o + 2, r, 2);
+	}
+#else
+	for(i = 0; i < count; i++)
+	{
+		const vec3_t *p = (const vec3_t*)((const char*)in + i * in_stride);
+		vec3_t *o = (vec3_t*)((char*)out + i * out_stride);
+		*o = mat4_mul_vec4_scalar(M, vec4(p->x, p->y, p->z, w)).xyz;
+	}
+#endif
+}
+static inline void mat4_mul_points(mat4_t M, vec3_t *out, const vec3_t *in,
+		int count)
+{
+	mat4_mul_vec3_strided(M, out, sizeof(*out), in, sizeof(*in), count, 1.0f);
+}
+/* normals and directions, translation is ignored */
+static inline void mat4_mul_dirs(mat4_t M, vec3_t *out, const vec3_t *in,
+		int count)
+{
+	mat4_mul_vec3_strided(M, out, sizeof(*out), in, sizeof(*in), count, 0.0f);
+}
+
+/* Same over separate x, y and z arrays, several points per step. */
+static inline void mat4_mul_vec3_soa(mat4_t M, n_t *ox, n_t *oy, n_t *oz,
+		const n_t *x, const n_t *y, const n_t *z, int count, n_t w)
+{
+	int i = 0;
+#if defined(MAFS_AVX)
+	for(; i + 8 <= count; i += 8)
+	{
+		__m256 px = _mm256_loadu_ps(x + i);
+		__m256 py = _mm256_loadu_ps(y + i);
+		__m256 pz = _mm256_loadu_ps(z + i);
+		__m256 r[3];
+		int j;
+		for(j = 0; j < 3; j++)
+		{
+			r[j] = _mm256_set1_ps(M._[3]._[j] * w);
+			r[j] = _mm256_add_ps(r[j], _mm256_mul_ps(_mm256_set1_ps(M._[0]._[j]), px));
+			r[j] = _mm256_add_ps(r[j], _mm256_mul_ps(_mm256_set1_ps(M._[1]._[j]), py));
+			r[j] = _mm256_add_ps(r[j], _mm256_mul_ps(_mm256_set1_ps(M._[2]._[j]), pz));
+		}
+		_mm256_storeu_ps(ox + i, r[0]);
+		_mm256_storeu_ps(oy + i, r[1]);
+		_mm256_storeu_ps(oz + i, r[2]);
+	}
+#endif
+#if defined(MAFS_SSE)
+	for(; i + 4 <= count; i += 4)
+	{
+		__m128 px = _mm_loadu_ps(x + i);
+		__m128 py = _mm_loadu_ps(y + i);
+		__m128 pz = _mm_loadu_ps(z + i);
+		__m128 r[3];
+		int j;
+		for(j = 0; j < 3; j++)
+		{
+			r[j] = _mm_set1_ps(M._[3]._[j] * w);
+			r[j] = _mm_add_ps(r[j], _mm_mul_ps(_mm_set1_ps(M._[0]._[j]), px));
+			r[j] = _mm_add_ps(r[j], _mm_mul_ps(_mm_set1_ps(M._[1]._[j]), py));
+			r[j] = _mm_add_ps(r[j], _mm_mul_ps(_mm_set1_ps(M._[2]._[j]), pz));
+		}
+		_mm_storeu_ps(ox + i, r[0]);
+		_mm_storeu_ps(oy + i, r[1]);
+		_mm_storeu_ps(oz + i, r[2]);
+	}
+#elif defined(MAFS_NEON)
+	for(; i + 4 <= count; i += 4)
+	{
+		float32x4_t px = vld1q_f32(x + i);
+		float32x4_t py = vld1q_f32(y + i);
+		float32x4_t pz = vld1q_f32(z + i);
+		float32x4_t r[3];
+		int j;
+		for(j = 0; j < 3; j++)
+		{
+			r[j] = vdupq_n_f32(M._[3]._[j] * w);
+			r[j] = vmlaq_n_f32(r[j], px, M._[0]._[j]);
+			r[j] = vmlaq_n_f32(r[j], py, M._[1]._[j]);
+			r[j] = vmlaq_n_f32(r[j], pz, M._[2]._[j]);
+		}
+		vst1q_f32(ox + i, r[0]);
+		vst1q_f32(oy + i, r[1]);
+		vst1q_f32(oz + i, r[2]);
+	}
+#endif
+	for(; i < count; i++)
+	{
+		n_t px = x[i], py = y[i], pz = z[i];
+		ox[i] = M._[0]._[0] * px + M._[1]._[0] * py + M._[2]._[0] * pz + M._[3]._[0] * w;
+		oy[i] = M._[0]._[1] * px + M._[1]._[1] * py + M._[2]._[1] * pz + M._[3]._[1] * w;
+		oz[i] = M._[0]._[2] * px + M._[1]._[2] * py + M._[2]._[2] * pz + M._[3]._[2] * w;
+	}
+}
+#endif
 static inline mat4_t mat4_translate(n_t x, n_t y, n_t z)
 {
 	mat4_t T = mat4();
@@ -629,7 +856,7 @@ static inline mat4_t mat4_rotate_Z(mat4_t Q, mat4_t M, n_t angle)
 	}};
 	return mat4_mul(M, R);
 }
-static inline mat4_t mat4_invert(mat4_t M)
+static inline mat4_t mat4_invert_scalar(mat4_t M)
 {
 	mat4_t T;
 	n_t s[6];
@@ -672,6 +899,83 @@ static inline mat4_t mat4_invert(mat4_t M)
 	T._[3]._[3] = ( M._[2]._[0] * s[3] - M._[2]._[1] * s[1] + M._[2]._[2] * s[0]) * idet;
 	return T;
 }
+#ifdef MAFS_SSE
+#define _MAFS_SHUF(a, b, x, y, z, w) \
+	_mm_shuffle_ps(a, b, (x) | ((y) << 2) | ((z) << 4) | ((w) << 6))
+#define _MAFS_SWZ(a, x, y, z, w) _MAFS_SHUF(a, a, x, y, z, w)
+/* 2x2 blocks stored as (m00, m01, m10, m11): A B, adj(A) B and A adj(B) */
+static inline __m128 _mafs_mat2_mul(__m128 a, __m128 b)
+{
+	return _mm_add_ps(_mm_mul_ps(a, _MAFS_SWZ(b, 0, 3, 0, 3)),
+			_mm_mul_ps(_MAFS_SWZ(a, 1, 0, 3, 2), _MAFS_SWZ(b, 2, 1, 2, 1)));
+}
+static inline __m128 _mafs_mat2_adj_mul(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(_mm_mul_ps(_MAFS_SWZ(a, 3, 3, 0, 0), b),
+			_mm_mul_ps(_MAFS_SWZ(a, 1, 1, 2, 2), _MAFS_SWZ(b, 2, 3, 0, 1)));
+}
+static inline __m128 _mafs_mat2_mul_adj(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(_mm_mul_ps(a, _MAFS_SWZ(b, 3, 0, 3, 0)),
+			_mm_mul_ps(_MAFS_SWZ(a, 1, 0, 3, 2), _MAFS_SWZ(b, 2, 1, 2, 1)));
+}
+#endif
+/* Inverse by 2x2 blocks. Since inv(M)^T is inv(M^T), the row major
+ * formulation applies to columns as they are. Assumes it is invertible. */
+static inline mat4_t mat4_invert(mat4_t M)
+{
+#ifdef MAFS_SSE
+	mat4_t T;
+	__m128 m0 = _mm_loadu_ps(M._[0]._);
+	__m128 m1 = _mm_loadu_ps(M._[1]._);
+	__m128 m2 = _mm_loadu_ps(M._[2]._);
+	__m128 m3 = _mm_loadu_ps(M._[3]._);
+
+	__m128 A = _mm_movelh_ps(m0, m1);
+	__m128 B = _mm_movehl_ps(m1, m0);
+	__m128 C = _mm_movelh_ps(m2, m3);
+	__m128 D = _mm_movehl_ps(m3, m2);
+
+	/* (|A|, |B|, |C|, |D|) */
+	__m128 det = _mm_sub_ps(
+			_mm_mul_ps(_MAFS_SHUF(m0, m2, 0, 2, 0, 2),
+				_MAFS_SHUF(m1, m3, 1, 3, 1, 3)),
+			_mm_mul_ps(_MAFS_SHUF(m0, m2, 1, 3, 1, 3),
+				_MAFS_SHUF(m1, m3, 0, 2, 0, 2)));
+	__m128 det_a = _MAFS_SWZ(det, 0, 0, 0, 0);
+	__m128 det_b = _MAFS_SWZ(det, 1, 1, 1, 1);
+	__m128 det_c = _MAFS_SWZ(det, 2, 2, 2, 2);
+	__m128 det_d = _MAFS_SWZ(det, 3, 3, 3, 3);
+
+	__m128 d_c = _mafs_mat2_adj_mul(D, C);
+	__m128 a_b = _mafs_mat2_adj_mul(A, B);
+	__m128 X = _mm_sub_ps(_mm_mul_ps(det_d, A), _mafs_mat2_mul(B, d_c));
+	__m128 W = _mm_sub_ps(_mm_mul_ps(det_a, D), _mafs_mat2_mul(C, a_b));
+	__m128 Y = _mm_sub_ps(_mm_mul_ps(det_b, C), _mafs_mat2_mul_adj(D, a_b));
+	__m128 Z = _mm_sub_ps(_mm_mul_ps(det_c, B), _mafs_mat2_mul_adj(A, d_c));
+
+	/* |M| = |A||D| + |B||C| - tr(adj(A) B adj(D) C) */
+	__m128 tr = _mm_mul_ps(a_b, _MAFS_SWZ(d_c, 0, 2, 1, 3));
+	tr = _mm_add_ps(tr, _MAFS_SWZ(tr, 2, 3, 0, 1));
+	tr = _mm_add_ps(tr, _MAFS_SWZ(tr, 1, 0, 3, 2));
+	__m128 det_m = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_a, det_d),
+				_mm_mul_ps(det_b, det_c)), tr);
+
+	__m128 idet = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), det_m);
+	X = _mm_mul_ps(X, idet);
+	Y = _mm_mul_ps(Y, idet);
+	Z = _mm_mul_ps(Z, idet);
+	W = _mm_mul_ps(W, idet);
+
+	_mm_storeu_ps(T._[0]._, _MAFS_SHUF(X, Y, 3, 1, 3, 1));
+	_mm_storeu_ps(T._[1]._, _MAFS_SHUF(X, Y, 2, 0, 2, 0));
+	_mm_storeu_ps(T._[2]._, _MAFS_SHUF(Z, W, 3, 1, 3, 1));
+	_mm_storeu_ps(T._[3]._, _MAFS_SHUF(Z, W, 2, 0, 2, 0));
+	return T;
+#else
+	return mat4_invert_scalar(M);
+#endif
+}
 static inline mat4_t mat4_orthonormalize(mat4_t M)
 {
 	mat4_t R = M;
@@ -929,7 +1233,7 @@ v' = v + q.w * t + cross(q.xyz, t)
 	r = vec3_add(r, u);
 	return r;
 }
-static inline mat4_t mat4_from_quat(vec4_t q)
+static inline mat4_t mat4_from_quat_scalar(vec4_t q)
 {
 	mat4_t M;
 	n_t a = q.w;
@@ -960,6 +1264,46 @@ static inline mat4_t mat4_from_quat(vec4_t q)
 	M._[3]._[3] = 1.f;
 	return M;
 }
+static inline mat4_t mat4_from_quat(vec4_t q)
+{
+#ifdef MAFS_SSE
+	/* each column sums q_j times a signed permutation of q */
+	mat4_t M;
+	__m128 Q = _mm_loadu_ps(q._);
+	__m128 x = _MAFS_SWZ(Q, 0, 0, 0, 0);
+	__m128 y = _MAFS_SWZ(Q, 1, 1, 1, 1);
+	__m128 z = _MAFS_SWZ(Q, 2, 2, 2, 2);
+	__m128 w = _MAFS_SWZ(Q, 3, 3, 3, 3);
+	__m128 c;
+#define _MAFS_QTERM(s, x_, y_, z_, w_, a_, b_, c_, d_) \
+	_mm_mul_ps(s, _mm_mul_ps(_MAFS_SWZ(Q, x_, y_, z_, w_), \
+				_mm_setr_ps(a_, b_, c_, d_)))
+
+	c = _MAFS_QTERM(x, 0, 1, 2, 3, 1.f, 2.f, 2.f, 0.f);
+	c = _mm_add_ps(c, _MAFS_QTERM(y, 1, 0, 0, 0, -1.f, 0.f, 0.f, 0.f));
+	c = _mm_add_ps(c, _MAFS_QTERM(z, 2, 0, 0, 0, -1.f, 0.f, 0.f, 0.f));
+	c = _mm_add_ps(c, _MAFS_QTERM(w, 3, 2, 1, 0, 1.f, 2.f, -2.f, 0.f));
+	_mm_storeu_ps(M._[0]._, c);
+
+	c = _MAFS_QTERM(x, 1, 0, 3, 0, 2.f, -1.f, 2.f, 0.f);
+	c = _mm_add_ps(c, _MAFS_QTERM(y, 0, 1, 2, 0, 0.f, 1.f, 2.f, 0.f));
+	c = _mm_add_ps(c, _MAFS_QTERM(z, 0, 2, 0, 0, 0.f, -1.f, 0.f, 0.f));
+	c = _mm_add_ps(c, _MAFS_QTERM(w, 2, 3, 0, 0, -2.f, 1.f, 0.f, 0.f));
+	_mm_storeu_ps(M._[1]._, c);
+
+	c = _MAFS_QTERM(x, 2, 3, 0, 0, 2.f, -2.f, -1.f, 0.f);
+	c = _mm_add_ps(c, _MAFS_QTERM(y, 3, 2, 1, 0, 2.f, 2.f, -1.f, 0.f));
+	c = _mm_add_ps(c, _MAFS_QTERM(z, 0, 0, 2, 0, 0.f, 0.f, 1.f, 0.f));
+	c = _mm_add_ps(c, _MAFS_QTERM(w, 0, 0, 3, 0, 0.f, 0.f, 1.f, 0.f));
+	_mm_storeu_ps(M._[2]._, c);
+#undef _MAFS_QTERM
+
+	M._[3] = vec4(0.f, 0.f, 0.f, 1.f);
+	return M;
+#else
+	return mat4_from_quat_scalar(q);
+#endif
+}
 
 static inline mat4_t mat4_mul_quat(mat4_t M, vec4_t q)
 {
@@ -974,37 +1318,68 @@ static inline mat4_t mat4_mul_quat(mat4_t M, vec4_t q)
 	R._[3]._[3] = 1.f;
 	return R;
 }
+/* M's upper 3x3 must be a rotation, scale has to be divided out first */
 static inline vec4_t quat_from_mat4(mat4_t M)
 {
 	vec4_t q;
-	n_t r=0.f;
-	int i;
-
-	int perm[] = { 0, 1, 2, 0, 1 };
-	int *p = perm;
-
-	for(i = 0; i<3; i++) {
-		n_t m = M._[i]._[i];
-		if( m < r )
-			continue;
-		m = r;
-		p = &perm[i];
+	n_t s;
+	n_t trace = M._[0]._[0] + M._[1]._[1] + M._[2]._[2];
+
+	/* Shepperd: divide by the largest of the four candidates */
+	if(trace > 0.f)
+	{
+		s = sqrtf(trace + 1.f) * 2.f;
+		q.w = s / 4.f;
+		q.x = (M._[1]._[2] - M._[2]._[1]) / s;
+		q.y = (M._[2]._[0] - M._[0]._[2]) / s;
+		q.z = (M._[0]._[1] - M._[1]._[0]) / s;
 	}
-
-	r = sqrtf(1.f + M._[p[0]]._[p[0]] - M._[p[1]]._[p[1]] - M._[p[2]]._[p[2]] );
-
-	if(r < 1e-6) {
-		q._[0] = 1.f;
-		q._[1] = q._[2] = q._[3] = 0.f;
-		return q;
+	else if(M._[0]._[0] > M._[1]._[1] && M._[0]._[0] > M._[2]._[2])
+	{
+		s = sqrtf(1.f + M._[0]._[0] - M._[1]._[1] - M._[2]._[2]) * 2.f;
+		q.w = (M._[1]._[2] - M._[2]._[1]) / s;
+		q.x = s / 4.f;
+		q.y = (M._[1]._[0] + M._[0]._[1]) / s;
+		q.z = (M._[2]._[0] + M._[0]._[2]) / s;
+	}
+	else if(M._[1]._[1] > M._[2]._[2])
+	{
+		s = sqrtf(1.f + M._[1]._[1] - M._[0]._[0] - M._[2]._[2]) * 2.f;
+		q.w = (M._[2]._[0] - M._[0]._[2]) / s;
+		q.x = (M._[1]._[0] + M._[0]._[1]) / s;
+		q.y = s / 4.f;
+		q.z = (M._[2]._[1] + M._[1]._[2]) / s;
+	}
+	else
+	{
+		s = sqrtf(1.f + M._[2]._[2] - M._[0]._[0] - M._[1]._[1]) * 2.f;
+		q.w = (M._[0]._[1] - M._[1]._[0]) / s;
+		q.x = (M._[2]._[0] + M._[0]._[2]) / s;
+		q.y = (M._[2]._[1] + M._[1]._[2]) / s;
+		q.z = s / 4.f;
 	}
-
-	q.x = r/2.f;
-	q.y = (M._[p[0]]._[p[1]] - M._[p[1]]._[p[0]])/(2.f*r);
-	q.z = (M._[p[2]]._[p[0]] - M._[p[0]]._[p[2]])/(2.f*r);
-	q.w = (M._[p[2]]._[p[1]] - M._[p[1]]._[p[2]])/(2.f*r);
 	return q;
 }
+static inline vec4_t quat_slerp(vec4_t a, vec4_t b, n_t t)
+{
+	n_t d = quat_inner_product(a, b);
+	n_t th, s;
+
+	/* q and -q are the same rotation, take the short way */
+	if(d < 0.f)
+	{
+		b = quat_scale(b, -1.f);
+		d = -d;
+	}
+	/* nearly parallel, sin(th) would vanish */
+	if(d > 0.9995f)
+		return vec4_norm(vec4_mix(a, b, t));
+
+	th = acosf(d);
+	s = sinf(th);
+	return quat_add(quat_scale(a, sinf((1.f - t) * th) / s),
+			quat_scale(b, sinf(t * th) / s));
+}
 
 typedef struct mat3_t { union {
 	struct { vec3_t a, b, c, d; };
@@ -102,6 +102,7 @@ mesh_t *mesh_new()
 	vector_alloc(self->edges, 100);
 
 	self->sem = SDL_CreateSemaphore(1);
+	self->refs = 1;
 
 	return self;
 }
@@ -177,6 +178,19 @@ void mesh_destroy(mesh_t *self)
 
 }
 
+mesh_t *mesh_ref(mesh_t *self)
+{
+	__sync_fetch_and_add(&self->refs, 1);
+	return self;
+}
+
+void mesh_release(mesh_t *self)
+{
+	if(__sync_sub_and_fetch(&self->refs, 1)) return;
+	mesh_destroy(self);
+	free(self);
+}
+
 static vec3_t get_normal(vec3_t p1, vec3_t p2, vec3_t p3)
 {
 	vec3_t res;
@@ -1234,10 +1248,9 @@ void mesh_add_quad(mesh_t *self,
 	edge_t *e2 = vector_get(self->edges, ie2); edge_init(e2);
 	edge_t *e3 = vector_get(self->edges, ie3); edge_init(e3);
 
-	v1n = mat4_mul_vec4(self->transformation, vec4(_vec3(v1n), 0.0)).xyz;
-	v2n = mat4_mul_vec4(self->transformation, vec4(_vec3(v2n), 0.0)).xyz;
-	v3n = mat4_mul_vec4(self->transformation, vec4(_vec3(v3n), 0.0)).xyz;
-	v4n = mat4_mul_vec4(self->transformation, vec4(_vec3(v4n), 0.0)).xyz;
+	vec3_t ns[4] = {v1n, v2n, v3n, v4n};
+	mat4_mul_dirs(self->transformation, ns, ns, 4);
+	v1n = ns[0]; v2n = ns[1]; v3n = ns[2]; v4n = ns[3];
 
 	face->e[0] = ie0;
 	face->e[1] = ie1;
@@ -1381,9 +1394,9 @@ int mesh_add_triangle(mesh_t *self,
 	edge_t *e1 = vector_get(self->edges, ie1); edge_init(e1);
 	edge_t *e2 = vector_get(self->edges, ie2); edge_init(e2);
 
-	v1n = mat4_mul_vec4(self->transformation, vec4(_vec3(v1n), 0.0)).xyz;
-	v2n = mat4_mul_vec4(self->transformation, vec4(_vec3(v2n), 0.0)).xyz;
-	v3n = mat4_mul_vec4(self->transformation, vec4(_vec3(v3n), 0.0)).xyz;
+	vec3_t ns[3] = {v1n, v2n, v3n};
+	mat4_mul_dirs(self->transformation, ns, ns, 3);
+	v1n = ns[0]; v2n = ns[1]; v3n = ns[2];
 
 	face->e[0] = ie0;
 	face->e[1] = ie1;
@@ -2175,6 +2188,49 @@ vertex_t *mesh_farthest(mesh_t *self, const vec3_t dir)
 	return v;
 }
 
+#define MESH_BATCH 64
+void mesh_farthest_axes(mesh_t *self, mat4_t axes, vertex_t *max[3],
+		vertex_t *min[3])
+{
+	/* the rows of axes are the directions, so projecting a chunk of
+	 * positions is one batched transform */
+	vec3_t pos[MESH_BATCH], proj[MESH_BATCH];
+	vertex_t *verts[MESH_BATCH];
+	vec3_t hi = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	vec3_t lo = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	int i, j, k, n = 0;
+	int count = vector_count(self->verts);
+
+	for(k = 0; k < 3; k++) max[k] = min[k] = NULL;
+
+	for(i = 0; i <= count; i++)
+	{
+		vertex_t *v = i < count ? m_vert(self, i) : NULL;
+		if(v)
+		{
+			verts[n] = v;
+			pos[n++] = XYZ(v->pos);
+		}
+		if(n < MESH_BATCH && (i < count || !n)) continue;
+
+		mat4_mul_dirs(axes, proj, pos, n);
+		for(j = 0; j < n; j++) for(k = 0; k < 3; k++)
+		{
+			if(proj[j]._[k] > hi._[k])
+			{
+				hi._[k] = proj[j]._[k];
+				max[k] = verts[j];
+			}
+			if(proj[j]._[k] < lo._[k])
+			{
+				lo._[k] = proj[j]._[k];
+				min[k] = verts[j];
+			}
+		}
+		n = 0;
+	}
+}
+
 static vec3_t mesh_support(mesh_t *self, const vec3_t dir)
 {
 	return XYZ(mesh_farthest(self, dir)->pos);
@@ -207,6 +207,8 @@ typedef struct mesh_t
 	float smooth_max;
 
 	SDL_sem *sem;
+	/* see mesh_ref */
+	int refs;
 } mesh_t;
 
 #ifdef MESH4
@@ -219,6 +221,10 @@ typedef struct mesh_t
 
 mesh_t *mesh_new(void);
 void mesh_destroy(mesh_t *self);
+/* Meshes are shared by the models instanced from one prefab. mesh_new
+ * hands out the first reference, the last mesh_release destroys it. */
+mesh_t *mesh_ref(mesh_t *self);
+void mesh_release(mesh_t *self);
 
 void mesh_load(mesh_t *self, const char *filename);
 mesh_t *mesh_quad(void);
@@ -314,6 +320,8 @@ int mesh_update_flips(mesh_t *self);
 vecN_t mesh_get_selection_center(mesh_t *self);
 
 vertex_t *mesh_farthest(mesh_t *self, const vec3_t dir);
+void mesh_farthest_axes(mesh_t *self, mat4_t axes, vertex_t *max[3],
+		vertex_t *min[3]);
 float mesh_get_margin(const mesh_t *self);
 
 /* COLLISIONS */
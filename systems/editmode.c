@@ -32,7 +32,7 @@ vec2_t c_editmode_bind_over(c_editmode_t *self)
 {
 	if(self->mode == EDIT_OBJECT)
 	{
-		return int_to_vec2(self->over);
+		return int_to_vec2(entity_index(self->over));
 	}
 	else
 	{
@@ -44,7 +44,7 @@ vec2_t c_editmode_bind_selected(c_editmode_t *self)
 {
 	if(self->mode == EDIT_OBJECT)
 	{
-		return int_to_vec2(self->selected);
+		return int_to_vec2(entity_index(self->selected));
 	}
 	else
 	{
@@ -85,7 +85,6 @@ void c_editmode_activate(c_editmode_t *self)
 		c_spacial_unlock(sc);
 	}
 	c_camera_activate(c_camera(&self->camera));
-	c_camera_update_view(c_camera(&self->camera));
 	c_renderer(self)->camera = self->camera;
 
 }
@@ -131,24 +130,49 @@ static int c_editmode_activate_loader(c_editmode_t *self)
 }
 
 void c_editmode_update_mouse(c_editmode_t *self, float x, float y)
+{
+	SDL_AtomicLock(&self->pick_lock);
+	self->pick_over = 1;
+	self->over_x = x;
+	self->over_y = y;
+	SDL_AtomicUnlock(&self->pick_lock);
+}
+
+/* last picked world position under the mouse, safe from any thread */
+vec3_t c_editmode_mouse_position(c_editmode_t *self, float *depth)
+{
+	vec3_t pos;
+	SDL_AtomicLock(&self->pick_lock);
+	pos = self->mouse_position;
+	if(depth) *depth = self->mouse_depth;
+	SDL_AtomicUnlock(&self->pick_lock);
+	return pos;
+}
+
+static void c_editmode_pick_over(c_editmode_t *self, float x, float y)
 {
 	c_renderer_t *renderer = c_renderer(self);
 	c_camera_t *cam = c_camera(&renderer->camera);
 	float px = x / renderer->width;
 	float py = 1.0f - y / renderer->height;
+	int poly;
+	float depth;
 	entity_t result = c_renderer_entity_at_pixel(renderer,
-			x, y, &self->mouse_depth);
+			x, y, &depth, &poly);
 
-	vec3_t pos = c_camera_real_pos(cam, self->mouse_depth, vec2(px, py));
+	vec3_t pos = c_camera_real_pos(cam, depth, vec2(px, py));
+	SDL_AtomicLock(&self->pick_lock);
+	self->mouse_depth = depth;
 	self->mouse_position = pos;
+	SDL_AtomicUnlock(&self->pick_lock);
 
 	if(self->mode == EDIT_OBJECT)
 	{
-		self->over = result & 0xFFFF;
+		self->over = result;
 	}
 	else
 	{
-		self->over_poly = result >> 16;
+		self->over_poly = poly;
 	}
 }
 
@@ -164,15 +188,19 @@ int c_editmode_mouse_move(c_editmode_t *self, mouse_move_data *event)
 				c_camera_t *cam = c_camera(&renderer->camera);
 
 				c_spacial_t *sc = c_spacial(&self->selected);
+				if(!sc) return 1;
+				float depth;
+				vec3_t mouse_pos = c_editmode_mouse_position(self, &depth);
 				if(!self->dragging)
 				{
 					self->dragging = 1;
-					self->drag_diff = vec3_sub(sc->pos, self->mouse_position);
+					self->drag_diff = vec3_sub(sc->pos, mouse_pos);
 				}
 				float px = event->x / renderer->width;
 				float py = 1.0f - event->y / renderer->height;
 
-				vec3_t pos = c_camera_real_pos(cam, self->mouse_depth, vec2(px, py));
+				vec3_t pos = c_camera_live_real_pos(cam, depth,
+						vec2(px, py));
 
 				vec3_t new_pos = vec3_add(self->drag_diff, pos);
 				c_spacial_set_pos(sc, new_pos);
@@ -238,25 +266,53 @@ int c_editmode_mouse_release(c_editmode_t *self, mouse_button_data *event)
 	{
 		if(self->pressing)
 		{
-			entity_t result = c_renderer_entity_at_pixel(c_renderer(self),
-					event->x, event->y, NULL);
-
-			if(self->mode == EDIT_OBJECT)
-			{
-				self->selected = result & 0xFFFF;
-
-				c_editmode_open_entity(self, self->selected);
-			}
-			else
-			{
-				self->selected_poly = result >> 16;
-			}
+			SDL_AtomicLock(&self->pick_lock);
+			self->pick_select = 1;
+			self->select_x = event->x;
+			self->select_y = event->y;
+			SDL_AtomicUnlock(&self->pick_lock);
 		}
 	}
 	self->pressing = 0;
 	return 1;
 }
 
+static void c_editmode_pick_select(c_editmode_t *self, float x, float y)
+{
+	int poly;
+	entity_t result = c_renderer_entity_at_pixel(c_renderer(self),
+			x, y, NULL, &poly);
+
+	if(self->mode == EDIT_OBJECT)
+	{
+		self->selected = result;
+
+		c_editmode_open_entity(self, self->selected);
+	}
+	else
+	{
+		self->selected_poly = poly;
+	}
+}
+
+/* runs on the render thread, which owns the GL context */
+static void c_editmode_resolve_picks(c_editmode_t *self)
+{
+	int over, select;
+	float ox, oy, sx, sy;
+
+	SDL_AtomicLock(&self->pick_lock);
+	over = self->pick_over;
+	select = self->pick_select;
+	ox = self->over_x; oy = self->over_y;
+	sx = self->select_x; sy = self->select_y;
+	self->pick_over = self->pick_select = 0;
+	SDL_AtomicUnlock(&self->pick_lock);
+
+	if(over) c_editmode_pick_over(self, ox, oy);
+	if(select) c_editmode_pick_select(self, sx, sy);
+}
+
 
 int c_editmode_key_up(c_editmode_t *self, char *key)
 {
@@ -311,7 +367,7 @@ void node_node(c_editmode_t *self, c_node_t *node)
 	}
 	else
 	{
-		sprintf(buffer, "NODE_%ld", entity);
+		sprintf(buffer, "NODE_%llu", entity);
 	}
 	if(nk_tree_push_id(self->nk, NK_TREE_NODE, final_name, NK_MINIMIZED,
 				(int)entity))
@@ -401,7 +457,7 @@ int c_editmode_entity_window(c_editmode_t *self, entity_t ent)
 	c_name_t *name = c_name(&ent);
 	int res;
 	char buffer[64];
-	sprintf(buffer, "ENT_%ld", ent);
+	sprintf(buffer, "ENT_%llu", ent);
 	char *title = buffer;
 	if(name)
 	{
@@ -417,9 +473,9 @@ int c_editmode_entity_window(c_editmode_t *self, entity_t ent)
 
 		signal_t *sig = &g_ecm->signals[component_menu];
 
-		for(i = 0; i < sig->cts_size; i++)
+		for(i = 0; i < sig->listeners_size; i++)
 		{
-			ct_t *ct = ecm_get(sig->cts[i]);
+			ct_t *ct = ecm_get(sig->listeners[i].comp_type);
 			c_t *comp = ct_get(ct, ent);
 			if(comp && !ct->is_interaction)
 			{
@@ -450,6 +506,7 @@ int c_editmode_entity_window(c_editmode_t *self, entity_t ent)
 
 int c_editmode_draw(c_editmode_t *self)
 {
+	c_editmode_resolve_picks(self);
 	if(self->nk && (self->visible || self->control))
 	{
 		if (nk_begin(self->nk, "clidian",
@@ -535,6 +592,7 @@ void c_editmode_register()
 {
 	ct_t *ct = ct_new("c_editmode", &ct_editmode,
 			sizeof(c_editmode_t), (init_cb)c_editmode_init, 0);
+	ct_set_transient(ct);
 
 	signal_init(&global_menu, sizeof(struct nk_context*));
 	signal_init(&component_menu, sizeof(struct nk_context*));
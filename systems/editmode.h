@@ -31,6 +31,13 @@ typedef struct
 	int selected_poly;
 	int over_poly;
 
+	/* picking reads the id buffer back, so mouse handlers on the ticker
+	 * only leave a request and c_editmode_draw resolves it */
+	SDL_SpinLock pick_lock;
+	int pick_over, pick_select;
+	float over_x, over_y;
+	float select_x, select_y;
+
 	entity_t open_entities[16];
 	int open_entities_count;
 
@@ -53,6 +60,7 @@ c_editmode_t *c_editmode_new(void);
 void c_editmode_activate(c_editmode_t *self);
 void c_editmode_register(void);
 void c_editmode_update_mouse(c_editmode_t *self, float x, float y);
+vec3_t c_editmode_mouse_position(c_editmode_t *self, float *depth);
 void c_editmode_open_texture(c_editmode_t *self, texture_t *tex);
 
 #endif /* !EDITMODE_H */
@@ -7,6 +7,7 @@
 #include "../components/force.h"
 #include "../components/velocity.h"
 #include "../components/rigid_body.h"
+#include "../components/aabb.h"
 #include "../components/light.h"
 
 DEC_CT(ct_physics);
@@ -138,17 +139,20 @@ static void c_physics_handle_collisions(c_rigid_body_t *c1,
 			vec3(-width, rb->offset,  width),
 			vec3(-width, rb->offset, -width)
 		};
+		vec3_t *vel = &c_velocity_vel(vc);
+		vec3_t *computed_pos = &c_velocity_computed_pos(vc);
+		vec3_t pre_movement_pos = c_velocity_pre_movement_pos(vc);
 		int o;
 		float friction = 0.0;
 		for(o = 0; o < sizeof(offsets) / sizeof(*offsets); o++)
 		{
 			friction = fmax(handle_cols_for_offset(c, d, cb, offsets[o],
-						&vc->computed_pos, vc->pre_movement_pos), friction);
+						computed_pos, pre_movement_pos), friction);
 
 		}
-		if(vc->computed_pos.x == vc->pre_movement_pos.x) vc->velocity.x = 0;
-		if(vc->computed_pos.y == vc->pre_movement_pos.y) vc->velocity.y = 0;
-		if(vc->computed_pos.z == vc->pre_movement_pos.z) vc->velocity.z = 0;
+		if(computed_pos->x == pre_movement_pos.x) vel->x = 0;
+		if(computed_pos->y == pre_movement_pos.y) vel->y = 0;
+		if(computed_pos->z == pre_movement_pos.z) vel->z = 0;
 		/* if(friction) */
 		/* { */
 		/*	 vec3_t dec = vec3_scale(*new_vel, friction); */
@@ -163,38 +167,69 @@ static void c_physics_handle_collisions(c_rigid_body_t *c1,
 			c_velocity_t *v;
 			if((v = c_velocity(c1)))
 			{
-				v->velocity = vec3(0.0);
-				v->computed_pos = v->pre_movement_pos;
+				c_velocity_vel(v) = vec3(0.0);
+				c_velocity_computed_pos(v) = c_velocity_pre_movement_pos(v);
 			}
 			if((v = c_velocity(c2)))
 			{
-				v->velocity = vec3(0.0);
-				v->computed_pos = v->pre_movement_pos;
+				c_velocity_vel(v) = vec3(0.0);
+				c_velocity_computed_pos(v) = c_velocity_pre_movement_pos(v);
 			}
 		}
 	}
 }
 
+typedef struct
+{
+	ct_t *velocities;
+	vec3_t accel; /* forces summed and scaled by dt */
+	float dt;
+} integrate_t;
+
+static void c_physics_integrate(integrate_t *self, uint start, uint end)
+{
+	uint p, i;
+	for(p = start; p < end; p++)
+	{
+		c_velocity_t *vc;
+		uint count = self->velocities->pages[p].components_size;
+		vec3_t *vel = ct_column(self->velocities, p, VEL_VELOCITY);
+		vec3_t *pre = ct_column(self->velocities, p, VEL_PRE_MOVEMENT_POS);
+		vec3_t *col = ct_column(self->velocities, p, VEL_PRE_COLLISION_POS);
+		vec3_t *computed = ct_column(self->velocities, p, VEL_COMPUTED_POS);
+
+		for(i = 0; i < count; i++)
+		{
+			vc = (c_velocity_t*)ct_get_at(self->velocities, p, i);
+			pre[i] = c_spacial(vc)->pos;
+		}
+
+		/* packed columns only, this loop vectorizes */
+		for(i = 0; i < count; i++)
+		{
+			vel[i] = vec3_add(vel[i], self->accel);
+			computed[i] = col[i] = vec3_add(pre[i], vec3_scale(vel[i], self->dt));
+		}
+	}
+}
+
 static int c_physics_update(c_physics_t *self, float *dt)
 {
 	unsigned long i, j, p, p2;
 
-	ct_t *vels = ecm_get(ct_velocity);
 	ct_t *bodies = ecm_get(ct_rigid_body);
+	uint movers;
 
-	for(p = 0; p < vels->pages_size; p++)
-	for(i = 0; i < vels->pages[p].components_size; i++)
-	{
-		c_velocity_t *vc = (c_velocity_t*)ct_get_at(vels, p, i);
-
-		c_spacial_t *sc = c_spacial(vc);
-
-		vc->pre_movement_pos = sc->pos;
-		vc->velocity = c_physics_handle_forces(self, vc->velocity, dt);
+	/* integration only touches each mover's own velocity, every velocity
+	 * depends on a spacial so its pages can be walked directly */
+	integrate_t integrate = {ecm_get(ct_velocity),
+		c_physics_handle_forces(self, vec3(0.0), dt), *dt};
+	jobs_parallel_for(integrate.velocities->pages_size, 1,
+			(range_cb)c_physics_integrate, &integrate);
 
-		vc->pre_collision_pos = vc->computed_pos =
-			vec3_add(sc->pos, vec3_scale(vc->velocity, *dt));
-	}
+	/* collisions test the boxes, bring them up to date with every spacial
+	 * and mesh write since the last tick */
+	c_aabb_update_changed();
 
 	for(p = 0; p < bodies->pages_size; p++)
 	for(i = 0; i < bodies->pages[p].components_size; i++)
@@ -218,17 +253,18 @@ static int c_physics_update(c_physics_t *self, float *dt)
 		}
 	}
 
-	for(p = 0; p < vels->pages_size; p++)
-	for(i = 0; i < vels->pages[p].components_size; i++)
+	movers = query_update(self->movers);
+	for(i = 0; i < movers; i++)
 	{
-		c_velocity_t *vc = (c_velocity_t*)ct_get_at(vels, p, i);
-
-		c_spacial_t *sc = c_spacial(vc);
+		c_t **tuple = query_at(self->movers, i);
+		c_velocity_t *vc = (c_velocity_t*)tuple[0];
+		c_spacial_t *sc = (c_spacial_t*)tuple[1];
 
-		vc->normal = vec3_sub(vc->computed_pos, vc->pre_collision_pos);
+		vc->normal = vec3_sub(c_velocity_computed_pos(vc),
+				c_velocity_pre_collision_pos(vc));
 		if(vc->normal.x != vc->normal.x) vc->normal = vec3(0.0);
 
-		c_spacial_set_pos(sc, vc->computed_pos);
+		c_spacial_set_pos(sc, c_velocity_computed_pos(vc));
 	}
 
 	return 1;
@@ -236,6 +272,7 @@ static int c_physics_update(c_physics_t *self, float *dt)
 
 static void c_physics_init(c_physics_t *self)
 {
+	self->movers = query_new(2, ct_velocity, ct_spacial);
 }
 
 c_physics_t *c_physics_new()
@@ -249,8 +286,13 @@ void c_physics_register()
 {
 	ct_t *ct = ct_new("Physics", &ct_physics,
 			sizeof(c_physics_t), (init_cb)c_physics_init, 0);
+	ct_set_transient(ct);
 
 	ct_listener(ct, WORLD, world_update, c_physics_update);
+	ct_listener_reads(ct, world_update, 2, ct_force, ct_rigid_body);
+	/* moving spacials also runs their spacial_changed listeners */
+	ct_listener_writes(ct, world_update, 7, ct_velocity, ct_spacial, ct_node,
+			ct_aabb, ct_model, ct_camera, ct_probe);
 
 	signal_init(&collider_callback, 0);
 }
@@ -14,7 +14,9 @@ typedef float(*velocity_cb)(c_t *self, vec3_t pos);
 typedef struct c_physics_t
 {
 	c_t super;
-	/* currently, physics has no options */
+
+	/* entities having both velocity and spacial */
+	query_t *movers;
 } c_physics_t;
 
 DEF_CASTER(ct_physics, c_physics, c_physics_t)
@@ -608,14 +608,18 @@ void c_renderer_add_camera(c_renderer_t *self, entity_t camera)
 }
 
 entity_t c_renderer_entity_at_pixel(c_renderer_t *self, int x, int y,
-		float *depth)
+		float *depth, int *poly)
 {
 	entity_t result;
+	if(poly) *poly = 0;
 	if(!self->passes[0].output) return entity_null;
 
 	unsigned int res = texture_get_pixel(self->passes[0].output, 7,
 			x * self->resolution, y * self->resolution, depth);
-	result = res;
+	/* the id buffer packs the entity index in the low 16 bits and the
+	 * poly id in the high 16 */
+	if(poly) *poly = res >> 16;
+	result = ecm_entity_at(res & 0xFFFF);
 	return result;
 }
 
@@ -676,6 +680,7 @@ void c_renderer_register()
 {
 	ct_t *ct = ct_new("c_renderer", &ct_renderer,
 			sizeof(c_renderer_t), (init_cb)c_renderer_init, 1, ct_window);
+	ct_set_transient(ct);
 
 	ct_listener(ct, WORLD, window_resize, c_renderer_resize);
 
@@ -19,7 +19,7 @@ typedef struct uniform_t uniform_t;
 /* 	unsigned int draw_filter; */
 /* } gbuffer_t; */
 
-enum
+typedef enum
 {
 	PASS_FOR_EACH_LIGHT    = 1 << 0,
 	PASS_MIPMAPED 		   = 1 << 1,
@@ -195,7 +195,7 @@ void c_renderer_add_pass(c_renderer_t *self, const char *feed_name, int flags,
 void c_renderer_clear_shader(c_renderer_t *self, shader_t *shader);
 int c_renderer_scene_changed(c_renderer_t *self);
 entity_t c_renderer_entity_at_pixel(c_renderer_t *self, int x, int y,
-		float *depth);
+		float *depth, int *poly);
 
 void pass_set_model(pass_t *self, mat4_t model);
 
@@ -46,7 +46,7 @@ void c_sauces_mesh_reg(c_sauces_t *self, const char *name, mesh_t *mesh)
 	uint i = self->meshes_size++;
 	self->meshes = realloc(self->meshes,
 			sizeof(*self->meshes) * self->meshes_size);
-	self->meshes[i] = mesh;
+	self->meshes[i] = mesh_ref(mesh);
 	strncpy(mesh->name, name, sizeof(mesh->name));
 }
 
@@ -65,8 +65,9 @@ mesh_t *c_sauces_mesh_get(c_sauces_t *self, const char *name)
 	for(i = 0; i < self->meshes_size; i++)
 	{
 		mesh = self->meshes[i];
-		if(!strcmp(mesh->name, name)) return mesh;
+		if(!strcmp(mesh->name, name)) return mesh_ref(mesh);
 	}
+	/* the registry takes its own reference, this one is the caller's */
 	mesh = mesh_new();
 	strcpy(mesh->name, name);
 
@@ -168,6 +169,7 @@ void c_sauces_register()
 {
 	ct_t *ct = ct_new("c_sauces", &ct_sauces,
 			sizeof(c_sauces_t), (init_cb)c_sauces_init, 0);
+	ct_set_transient(ct);
 
 	ct_listener(ct, WORLD, component_menu, c_sauces_component_menu);
 }
@@ -33,6 +33,7 @@ void c_sauces_mat_reg(c_sauces_t *self, const char *name, mat_t *mat);
 texture_t *c_sauces_texture_get(c_sauces_t *self, const char *name);
 void c_sauces_texture_reg(c_sauces_t *self, const char *name, texture_t *texture);
 
+/* returns a reference owned by the caller, the registry keeps its own */
 mesh_t *c_sauces_mesh_get(c_sauces_t *self, const char *name);
 void c_sauces_mesh_reg(c_sauces_t *self, const char *name, mesh_t *mesh);
 
@@ -30,6 +30,13 @@ static void init_context_b(c_window_t *self)
 				SDL_GetError());
 		exit(1);
 	}
+	/* created current on the input thread, the render thread takes it */
+	SDL_GL_MakeCurrent(self->window, NULL);
+}
+
+void c_window_make_current(c_window_t *self)
+{
+	SDL_GL_MakeCurrent(self->window, self->context);
 
 	glInit();
 
@@ -49,6 +56,10 @@ static void init_context_b(c_window_t *self)
 	printf("GL Version (integer) : %d.%d\n", major, minor);
 	printf("GLSL Version : %s\n", glslVersion); 
 
+	entity_signal(c_entity(self), window_resize,
+			&(window_resize_data){
+			.width = self->width,
+			.height = self->height});
 }
 
 void c_window_init(c_window_t *self)
@@ -78,35 +89,38 @@ void c_window_init(c_window_t *self)
 	c_model(&self->quad)->visible = 0;
 }
 
-int c_window_toggle_fullscreen_gl(c_window_t *self)
+int c_window_apply_fullscreen(c_window_t *self, SDL_Event *resize)
 {
+	SDL_DisplayMode dm;
+	if(!SDL_AtomicSet(&self->fullscreen_request, 0)) return 0;
 
 	self->fullscreen = !self->fullscreen;
 
-	SDL_DisplayMode dm;
 	if(SDL_GetDesktopDisplayMode(0, &dm) != 0)
 	{
 		SDL_Log("SDL_GetDesktopDisplayMode failed: %s", SDL_GetError());
-		return 1;
+		return 0;
 	}
-	self->width = dm.w;
-	self->height = dm.h;
 
-	printf("window resize: %dx%d\n", self->width, self->height);
-	entity_signal(entity_null, window_resize,
-		&(window_resize_data){.width = self->width, .height = self->height});
-
-	SDL_SetWindowSize(self->window, self->width, self->height);
+	SDL_SetWindowSize(self->window, dm.w, dm.h);
 
 	SDL_SetWindowFullscreen(self->window,
 		self->fullscreen?SDL_WINDOW_FULLSCREEN_DESKTOP:0);
 
+	/* width and height belong to the render thread, which applies the
+	 * new size when it handles this */
+	memset(resize, 0, sizeof(*resize));
+	resize->type = SDL_WINDOWEVENT;
+	resize->window.event = SDL_WINDOWEVENT_RESIZED;
+	resize->window.windowID = SDL_GetWindowID(self->window);
+	resize->window.data1 = dm.w;
+	resize->window.data2 = dm.h;
 	return 1;
 }
+
 void c_window_toggle_fullscreen(c_window_t *self)
 {
-	loader_push(candle->loader, (loader_cb)c_window_toggle_fullscreen_gl,
-		NULL, (c_t*)self);
+	SDL_AtomicSet(&self->fullscreen_request, 1);
 }
 
 void c_window_handle_resize(c_window_t *self, const SDL_Event event)
@@ -122,11 +136,6 @@ void c_window_handle_resize(c_window_t *self, const SDL_Event event)
 int c_window_created(c_window_t *self)
 {
 	init_context_b(self);
-
-	entity_signal(c_entity(self), window_resize,
-			&(window_resize_data){
-			.width = self->width,
-			.height = self->height});
 	return 1;
 }
 
@@ -169,6 +178,7 @@ void c_window_register()
 {
 	ct_t *ct = ct_new("c_window", &ct_window,
 			sizeof(c_window_t), (init_cb)c_window_init, 0);
+	ct_set_transient(ct);
 
 	ct_listener(ct, ENTITY, entity_created, c_window_created);
 
@@ -18,7 +18,8 @@ typedef struct c_window_t
 	c_t super;
 
 	int width, height;
-	int fullscreen;
+	int fullscreen; /* input thread */
+	SDL_atomic_t fullscreen_request;
 
 	SDL_Window *window;
 	SDL_Renderer *display;
@@ -38,7 +39,14 @@ void c_window_rect(c_window_t *self, int x, int y, int width, int height,
 		texture_t *texture);
 
 void c_window_handle_resize(c_window_t *self, const SDL_Event event);
+/* any thread, applied by the input thread on its next pump */
 void c_window_toggle_fullscreen(c_window_t *self);
+/* input thread, returns 1 and fills resize with the event the render thread
+ * should see when a toggle was applied */
+int c_window_apply_fullscreen(c_window_t *self, SDL_Event *resize);
+/* render thread, takes the context the input thread created with the
+ * window */
+void c_window_make_current(c_window_t *self);
 
 c_window_t *c_window_new(int width, int height);
 void c_window_register(void);
@@ -0,0 +1,116 @@
+/* query_update_changed returns the components written after the tick it is
+ * given and nothing else, also when a removal moves the last component
+ * from the last page into the freed slot of an earlier page. Build with
+ * -DDEBUG and ideally a sanitizer. */
+#include <ecm.h>
+#include <stdlib.h>
+
+#define COUNT 80
+
+typedef struct
+{
+	c_t super;
+	int value;
+} c_changed_t;
+
+DEC_CT(ct_changed);
+
+static entity_t g_entities[COUNT];
+static int g_failed = 0;
+
+/* the query must hold exactly the n entities given */
+static void expect(const char *what, query_t *query, ulong since,
+		const entity_t *entities, uint n)
+{
+	uint found = query_update_changed(query, 0, since), i, j;
+	if(found != n)
+	{
+		printf("FAIL %s: %u changed, expected %u\n", what, found, n);
+		g_failed = 1;
+		return;
+	}
+	for(i = 0; i < n; i++)
+	{
+		for(j = 0; j < found; j++)
+		{
+			if(c_entity(query_at(query, j)[0]) == entities[i]) break;
+		}
+		if(j == found)
+		{
+			printf("FAIL %s: entity %u missing\n", what,
+					entity_index(entities[i]));
+			g_failed = 1;
+		}
+	}
+}
+
+/* the component a removal moves */
+static entity_t last_component(ct_t *ct)
+{
+	uint p = ct->pages_size - 1;
+	return c_entity(ct_get_at(ct, p, ct->pages[p].components_size - 1));
+}
+
+int main(void)
+{
+	ulong since;
+	entity_t moved, removed;
+	query_t *query;
+	ct_t *ct;
+	int i;
+
+	ecm_init();
+	ct = ct_new("changed", &ct_changed, sizeof(c_changed_t), NULL, 0);
+	ecm_generate_dispatch();
+	query = query_new(1, ct_changed);
+
+	for(i = 0; i < COUNT; i++)
+	{
+		_entity_new_pre();
+		component_new(ct_changed);
+		g_entities[i] = _entity_new(0);
+	}
+	expect("added", query, 0, g_entities, COUNT);
+
+	since = ecm_change_tick();
+	expect("untouched", query, since, NULL, 0);
+
+	/* a write after the tick shows up, one in a later page as well */
+	((c_changed_t*)ct_write(ct, ct_get(ct, g_entities[3])))->value = 1;
+	((c_changed_t*)ct_write(ct, ct_get(ct, g_entities[70])))->value = 1;
+	expect("written", query, since, (entity_t[]){g_entities[3],
+			g_entities[70]}, 2);
+
+	/* a newer tick hides those writes again */
+	since = ecm_change_tick();
+	expect("older writes", query, since, NULL, 0);
+
+	/* a written component moved by a removal keeps its write */
+	moved = last_component(ct);
+	ct_write(ct, ct_get(ct, moved));
+	removed = g_entities[5];
+	ct_remove(ct, removed);
+	if(last_component(ct) == moved || ct_index_load(ct_index(ct,
+				entity_index(moved))).page != 0)
+	{
+		printf("FAIL removal did not move the last slot\n");
+		g_failed = 1;
+	}
+	expect("moved written", query, since, &moved, 1);
+
+	/* an untouched component moved into a written slot stays untouched */
+	since = ecm_change_tick();
+	moved = last_component(ct);
+	removed = g_entities[6];
+	ct_write(ct, ct_get(ct, removed));
+	ct_remove(ct, removed);
+	if(!ct_get(ct, moved) || ct_get(ct, removed))
+	{
+		printf("FAIL removal\n");
+		g_failed = 1;
+	}
+	expect("moved untouched", query, since, NULL, 0);
+
+	if(!g_failed) printf("ecm_changed: ok\n");
+	return g_failed;
+}
@@ -0,0 +1,111 @@
+/* Jobs record commands concurrently, then one flush applies them. Each job
+ * creates an entity, signals it and for odd jobs destroys it again, which
+ * only works if a thread's commands run in the order they were recorded.
+ * The signal listener records a second signal, which must wait for the
+ * next flush. Build with -DDEBUG and ideally a sanitizer. */
+#include <ecm.h>
+#include <commands.h>
+#include <jobs.h>
+#include <stdlib.h>
+
+#define JOBS 4096
+
+typedef struct
+{
+	c_t super;
+	int value;
+	int signaled;
+	int echoed;
+} c_cmd_t;
+
+DEC_CT(ct_cmd);
+static DEC_SIG(cmd_value);
+static DEC_SIG(cmd_echo);
+
+static entity_t g_entities[JOBS];
+static int g_failed = 0;
+
+static void fail(const char *what, int i)
+{
+	printf("FAIL %s job %d\n", what, i);
+	g_failed = 1;
+}
+
+static void cmd_build(int *value)
+{
+	((c_cmd_t*)component_new(ct_cmd))->value = *value;
+}
+
+static int c_cmd_value(c_cmd_t *self, int *value)
+{
+	if(*value != self->value) fail("payload", *value);
+	self->signaled++;
+	cmd_signal(c_entity(self), cmd_echo, NULL);
+	return 1;
+}
+
+static int c_cmd_echo(c_cmd_t *self, void *data)
+{
+	self->echoed++;
+	return 1;
+}
+
+static void record(void *usrptr, uint start, uint end)
+{
+	uint i;
+	for(i = start; i < end; i++)
+	{
+		int value = i;
+		entity_t entity = cmd_entity_new((cmd_entity_cb)cmd_build, &value,
+				sizeof(value));
+		g_entities[i] = entity;
+		cmd_signal(entity, cmd_value, &value);
+		if(i & 1) cmd_entity_destroy(entity);
+	}
+}
+
+static void check(int echoed)
+{
+	ct_t *ct = ecm_get(ct_cmd);
+	int i;
+	for(i = 0; i < JOBS; i++)
+	{
+		c_cmd_t *c = (c_cmd_t*)ct_get(ct, g_entities[i]);
+		if(i & 1)
+		{
+			if(c || ecm_entity_alive(g_entities[i])) fail("destroyed", i);
+			continue;
+		}
+		if(!c) fail("created", i);
+		else if(c->value != i || c->signaled != 1) fail("signaled", i);
+		else if(c->echoed != echoed) fail("echoed", i);
+	}
+	if(ct_count(ct) != JOBS / 2) fail("count", ct_count(ct));
+}
+
+int main(void)
+{
+	ecm_init();
+	signal_init(&cmd_value, sizeof(int));
+	signal_init(&cmd_echo, 0);
+	ct_t *ct = ct_new("cmd", &ct_cmd, sizeof(c_cmd_t), NULL, 0);
+	ct_listener(ct, ENTITY, cmd_value, c_cmd_value);
+	ct_listener(ct, ENTITY, cmd_echo, c_cmd_echo);
+	ecm_generate_dispatch();
+	jobs_init(4);
+
+	/* the flushing thread has a buffer of its own behind the jobs' ones,
+	 * the echoes it records while flushing must still wait */
+	entity_t empty = cmd_entity_new(NULL, NULL, 0);
+	jobs_parallel_for(JOBS, 16, record, NULL);
+	commands_flush();
+	check(0);
+	if(!ecm_entity_alive(empty)) fail("empty entity", -1);
+	commands_flush();
+	check(1);
+	commands_flush();
+	check(1);
+
+	if(!g_failed) printf("ecm_commands: ok\n");
+	return g_failed;
+}
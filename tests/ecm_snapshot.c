@@ -0,0 +1,207 @@
+/* Saves a world, then loads truncated and corrupted copies of the snapshot,
+ * each of which must be rejected without touching the world, and finally
+ * the intact snapshot. Build with -DDEBUG and ideally a sanitizer. */
+#include <ecm.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COUNT 100
+
+typedef struct
+{
+	c_t super;
+	int value;
+	int check; /* restored by the load hook */
+} c_snap_t;
+
+DEC_CT(ct_snap);
+
+static entity_t g_entities[COUNT];
+static int g_alive[COUNT];
+static int g_failed = 0;
+
+static void c_snap_save(c_snap_t *self, FILE *fp)
+{
+	fwrite(&self->value, sizeof(self->value), 1, fp);
+}
+
+static void c_snap_load(c_snap_t *self, FILE *fp)
+{
+	if(fread(&self->check, sizeof(self->check), 1, fp) != 1) self->check = -1;
+}
+
+static int load(const char *buffer, long size)
+{
+	FILE *fp = tmpfile();
+	int result;
+	fwrite(buffer, 1, size, fp);
+	rewind(fp);
+	result = ecm_load(fp);
+	fclose(fp);
+	return result;
+}
+
+/* every live entity still holds the value it was given */
+static int world_intact(int offset)
+{
+	ct_t *ct = ecm_get(ct_snap);
+	uint alive = 0;
+	int i;
+	for(i = 0; i < COUNT; i++)
+	{
+		if(!g_alive[i]) continue;
+		c_snap_t *c = (c_snap_t*)ct_get(ct, g_entities[i]);
+		if(!ecm_entity_alive(g_entities[i]) || !c || c->value != i + offset)
+			return 0;
+		alive++;
+	}
+	return ct_count(ct) == alive;
+}
+
+static void expect_rejected(const char *what, const char *buffer, long size)
+{
+	if(load(buffer, size))
+	{
+		printf("FAIL %s loaded\n", what);
+		g_failed = 1;
+	}
+	else if(!world_intact(1000))
+	{
+		printf("FAIL %s changed the world\n", what);
+		g_failed = 1;
+	}
+}
+
+static void set_entity(char *buffer, long component, entity_t entity)
+{
+	memcpy(buffer + component + offsetof(c_t, entity), &entity,
+			sizeof(entity));
+}
+
+static entity_t get_entity(const char *buffer, long component)
+{
+	entity_t entity;
+	memcpy(&entity, buffer + component + offsetof(c_t, entity),
+			sizeof(entity));
+	return entity;
+}
+
+int main(void)
+{
+	char *snapshot, *copy;
+	long size, l, page, first;
+	uint pages, huge = 0x7fffffff;
+	ct_t *ct;
+	int i;
+
+	ecm_init();
+	ct = ct_new("snap", &ct_snap, sizeof(c_snap_t), NULL, 0);
+	ct_set_snapshot(ct, (snapshot_cb)c_snap_save, (snapshot_cb)c_snap_load);
+	ecm_generate_dispatch();
+
+	for(i = 0; i < COUNT; i++)
+	{
+		_entity_new_pre();
+		((c_snap_t*)component_new(ct_snap))->value = i;
+		g_entities[i] = _entity_new(0);
+		g_alive[i] = 1;
+	}
+	/* leave dead slots behind and partly filled pages */
+	for(i = 0; i < COUNT; i += 7)
+	{
+		entity_destroy(g_entities[i]);
+		g_alive[i] = 0;
+	}
+
+	FILE *fp = tmpfile();
+	if(!ecm_save(fp))
+	{
+		printf("FAIL save\n");
+		return 1;
+	}
+	size = ftell(fp);
+	snapshot = malloc(size);
+	copy = malloc(size);
+	rewind(fp);
+	if(fread(snapshot, 1, size, fp) != (size_t)size) return 1;
+	fclose(fp);
+
+	/* the world moves on, a rejected load must leave it like this */
+	for(i = 0; i < COUNT; i++)
+	{
+		if(g_alive[i])
+			((c_snap_t*)ct_get(ct, g_entities[i]))->value = i + 1000;
+	}
+
+	/* header, slot table, type count, then name and descriptor */
+	first = 3 * sizeof(uint) + g_ecm->entities_size * sizeof(entity_slot_t) +
+		sizeof(uint) + sizeof(ct->name);
+	page = first + 4 * sizeof(uint);
+	memcpy(&pages, snapshot + first + 3 * sizeof(uint), sizeof(pages));
+	if(pages < 2)
+	{
+		printf("FAIL expected several pages, got %u\n", pages);
+		return 1;
+	}
+	/* the first component of the first page */
+	first = page + sizeof(uint);
+
+	for(l = 0; l < size; l++)
+	{
+		char what[64];
+		sprintf(what, "truncated at %ld of %ld", l, size);
+		expect_rejected(what, snapshot, l);
+	}
+
+	memcpy(copy, snapshot, size);
+	memcpy(copy + page - sizeof(uint), &huge, sizeof(huge));
+	expect_rejected("huge page count", copy, size);
+
+	memcpy(copy, snapshot, size);
+	memcpy(copy + page, &(uint){ct->page_size - 1}, sizeof(uint));
+	expect_rejected("partial first page", copy, size);
+
+	memcpy(copy, snapshot, size);
+	set_entity(copy, first, entity_make(g_ecm->entities_size + 5, 1));
+	expect_rejected("entity out of range", copy, size);
+
+	memcpy(copy, snapshot, size);
+	set_entity(copy, first, entity_make(0, 0));
+	expect_rejected("null entity", copy, size);
+
+	memcpy(copy, snapshot, size);
+	l = entity_index(get_entity(copy, first));
+	set_entity(copy, first, entity_make(l, entity_gen(get_entity(copy, first))
+				+ 1));
+	expect_rejected("stale generation", copy, size);
+
+	memcpy(copy, snapshot, size);
+	set_entity(copy, first, get_entity(copy, first + sizeof(c_snap_t)));
+	expect_rejected("repeated entity", copy, size);
+
+	memcpy(copy, snapshot, size);
+	set_entity(copy, first, g_entities[0]);
+	expect_rejected("dead entity", copy, size);
+
+	if(!load(snapshot, size) || !world_intact(0))
+	{
+		printf("FAIL intact snapshot\n");
+		g_failed = 1;
+	}
+	for(i = 0; i < COUNT; i++)
+	{
+		c_snap_t *c = (c_snap_t*)ct_get(ct, g_entities[i]);
+		if(g_alive[i] && c->check != i)
+		{
+			printf("FAIL load hook entity %d\n", i);
+			g_failed = 1;
+			break;
+		}
+	}
+
+	free(snapshot);
+	free(copy);
+	if(!g_failed) printf("ecm_snapshot: ok\n");
+	return g_failed;
+}
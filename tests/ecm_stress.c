@@ -0,0 +1,248 @@
+/* Threads add, then remove, then add again components of shared types
+ * while others look them up, and the survivors are checked from one thread.
+ * A removal moves the last component of its page, so pointers from ct_add are
+ * only written before any thread starts removing. Then entities owning heap
+ * memory are spawned and killed in rounds, which must not grow anything.
+ * Build with -DDEBUG so stale lookups return NULL, and ideally a sanitizer. */
+#include <ecm.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THREADS 8
+#define ENTITIES 20000
+#ifndef READERS
+#define READERS 2
+#endif
+#define ROUNDS 50
+#define SPAWNS 5000
+
+typedef struct
+{
+	c_t super;
+	int thread;
+	int i;
+} c_stress_t;
+
+typedef struct
+{
+	c_t super;
+	char *buffer;
+} c_owner_t;
+
+DEC_CT(ct_stress_a);
+DEC_CT(ct_stress_b);
+DEC_CT(ct_stress_owner);
+
+static entity_t g_entities[THREADS][ENTITIES];
+static SDL_atomic_t g_writing;
+static SDL_atomic_t g_arrived;
+static SDL_atomic_t g_owned;
+static int g_failed = 0;
+
+static void fail(const char *what, int thread, int i)
+{
+	printf("FAIL %s thread %d entity %d\n", what, thread, i);
+	g_failed = 1;
+}
+
+/* waits until every writer has called it n times */
+static void writers_sync(int n)
+{
+	SDL_AtomicAdd(&g_arrived, 1);
+	while(SDL_AtomicGet(&g_arrived) < THREADS * n) SDL_Delay(0);
+}
+
+static void add(int t, int i, int with_b)
+{
+	_entity_new_pre();
+	c_stress_t *c = component_new(ct_stress_a);
+	c->thread = t;
+	c->i = i;
+	if(with_b)
+	{
+		c = component_new(ct_stress_b);
+		c->thread = t;
+		c->i = i;
+	}
+	__atomic_store_n(&g_entities[t][i], _entity_new(0), __ATOMIC_RELEASE);
+}
+
+static int writer(void *data)
+{
+	int t = (int)(long)data, i;
+	ct_t *a = ecm_get(ct_stress_a);
+
+	for(i = 0; i < ENTITIES; i++) add(t, i, i & 1);
+	writers_sync(1);
+
+	/* every third one goes, its slot is taken again below */
+	for(i = 0; i < ENTITIES; i += 3)
+	{
+		entity_destroy(g_entities[t][i]);
+	}
+	writers_sync(2);
+
+	for(i = 0; i < ENTITIES; i += 3)
+	{
+		add(t, i, 0);
+		if(!ct_get(a, g_entities[t][i])) fail("lookup after add", t, i);
+	}
+	SDL_AtomicAdd(&g_writing, -1);
+	return 0;
+}
+
+/* Random lookups racing the writers, of entities no writer destroys. The
+ * index is read raw because the DEBUG ct_get returns NULL on a mismatch
+ * instead of the other entity's component. A move leaves a copy behind in
+ * the old slot until an add reuses it, so a lookup that overlapped the
+ * start of a phase isn't checked. */
+static int reader(void *data)
+{
+	ct_t *a = ecm_get(ct_stress_a);
+	ulong seed = (ulong)data + 1;
+	uint lookups = 0;
+
+	while(SDL_AtomicGet(&g_writing))
+	{
+		seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+		int t = (seed >> 33) % THREADS;
+		int i = (seed >> 17) % ENTITIES;
+		if(i % 3 == 0) continue;
+		entity_t e = __atomic_load_n(&g_entities[t][i], __ATOMIC_ACQUIRE);
+		if(!e) continue;
+
+		int arrived = SDL_AtomicGet(&g_arrived);
+		struct comp_index index = ct_index_load(
+				ct_index(a, entity_index(e)));
+		if(index.offset == -1)
+		{
+			fail("live entity not indexed", t, i);
+			continue;
+		}
+		c_t *c = (c_t*)&a->pages[index.page].components[index.offset];
+		entity_t found = c->entity;
+		if(found != e && SDL_AtomicGet(&g_arrived) == arrived)
+		{
+			fail("lookup hit another entity", t, i);
+		}
+		lookups++;
+	}
+	printf("reader %lu: %u lookups\n", (ulong)data, lookups);
+	return 0;
+}
+
+static void c_owner_init(c_owner_t *self)
+{
+	self->buffer = malloc(256);
+	SDL_AtomicAdd(&g_owned, 1);
+}
+
+static int c_owner_destroyed(c_owner_t *self)
+{
+	free(self->buffer);
+	self->buffer = NULL;
+	SDL_AtomicAdd(&g_owned, -1);
+	return 1;
+}
+
+/* what a round of spawning may grow, it must all be reused afterwards */
+typedef struct
+{
+	uint entities_size;
+	uint entities_retired;
+	uint pages_alloc;
+	uint retired;
+	size_t arena_top;
+} footprint_t;
+
+static footprint_t footprint(ct_t *ct)
+{
+	return (footprint_t){g_ecm->entities_size, g_ecm->entities_retired_size,
+		ct->pages_alloc, ct->retired_size, ct->arena.top};
+}
+
+/* projectile style churn, every round spawns entities and kills them all */
+static void spawn_kill(void)
+{
+	static entity_t spawned[SPAWNS];
+	ct_t *owner = ecm_get(ct_stress_owner);
+	footprint_t first = {0};
+	int r, i;
+
+	for(r = 0; r < ROUNDS; r++)
+	{
+		for(i = 0; i < SPAWNS; i++)
+		{
+			_entity_new_pre();
+			component_new(ct_stress_owner);
+			component_new(ct_stress_a);
+			spawned[i] = _entity_new(0);
+		}
+		footprint_t now = footprint(owner);
+		if(r == 0) first = now;
+		if(memcmp(&now, &first, sizeof(now))) fail("spawn footprint", -1, r);
+
+		for(i = 0; i < SPAWNS; i++) entity_destroy(spawned[i]);
+		if(SDL_AtomicGet(&g_owned)) fail("owned buffers", -1, r);
+		if(ct_count(owner)) fail("owners left", -1, r);
+	}
+}
+
+int main(void)
+{
+	SDL_Thread *threads[THREADS + READERS + 1];
+	int t, i;
+
+	ecm_init();
+	ct_new("stress_a", &ct_stress_a, sizeof(c_stress_t), NULL, 0);
+	ct_new("stress_b", &ct_stress_b, sizeof(c_stress_t), NULL, 0);
+	ct_t *owner = ct_new("stress_owner", &ct_stress_owner, sizeof(c_owner_t),
+			(init_cb)c_owner_init, 0);
+	ct_listener(owner, ENTITY, entity_destroyed, c_owner_destroyed);
+	ecm_generate_dispatch();
+
+	SDL_AtomicSet(&g_writing, THREADS);
+	for(t = 0; t < THREADS; t++)
+	{
+		threads[t] = SDL_CreateThread(writer, "writer", (void*)(long)t);
+	}
+	for(t = 0; t < READERS; t++)
+	{
+		threads[THREADS + t] = SDL_CreateThread(reader, "reader",
+				(void*)(long)t);
+	}
+	for(t = 0; t < THREADS + READERS; t++)
+	{
+		SDL_WaitThread(threads[t], NULL);
+	}
+
+	ct_t *a = ecm_get(ct_stress_a);
+	ct_t *b = ecm_get(ct_stress_b);
+	uint expect_b = 0;
+	for(t = 0; t < THREADS; t++) for(i = 0; i < ENTITIES; i++)
+	{
+		entity_t e = g_entities[t][i];
+		c_stress_t *c = (c_stress_t*)ct_get(a, e);
+		if(!ecm_entity_alive(e) || !c || c->thread != t || c->i != i)
+		{
+			fail("survivor a", t, i);
+			continue;
+		}
+		/* replaced entities only got an a */
+		int has_b = (i & 1) && i % 3;
+		c = (c_stress_t*)ct_get(b, e);
+		if(has_b != !!c || (c && (c->thread != t || c->i != i)))
+		{
+			fail("survivor b", t, i);
+		}
+		expect_b += has_b;
+	}
+	if(ct_count(a) != THREADS * ENTITIES) fail("count a", -1, ct_count(a));
+	if(ct_count(b) != expect_b) fail("count b", -1, ct_count(b));
+
+	spawn_kill();
+	if(ct_count(a) != THREADS * ENTITIES) fail("count a", -1, ct_count(a));
+
+	printf(g_failed ? "ecm_stress: FAIL\n" : "ecm_stress: ok\n");
+	return g_failed;
+}
@@ -0,0 +1,164 @@
+/* Compares the SIMD mafs kernels picked for this build against their
+ * scalar versions. Build with -DMAFS_NO_SIMD to check the test itself. */
+#include <mafs.h>
+#include <stdlib.h>
+
+#define RUNS 100000
+#define TOLERANCE 1e-5f
+
+static int g_failed = 0;
+
+static float rnd(void)
+{
+	return (rand() / (float)RAND_MAX) * 4.0f - 2.0f;
+}
+
+static mat4_t rnd_mat4(void)
+{
+	mat4_t M;
+	int i, j;
+	for(i = 0; i < 4; i++) for(j = 0; j < 4; j++) M._[i]._[j] = rnd();
+	return M;
+}
+
+static float mat4_diff(mat4_t a, mat4_t b)
+{
+	float d = 0.0f;
+	int i, j;
+	for(i = 0; i < 4; i++) for(j = 0; j < 4; j++)
+	{
+		float e = fabsf(a._[i]._[j] - b._[i]._[j]);
+		if(e > d) d = e;
+	}
+	return d;
+}
+
+static void report(const char *name, float err, float tolerance)
+{
+	int ok = err <= tolerance;
+	printf("%-10s %s max error %g\n", name, ok ? "ok  " : "FAIL", err);
+	if(!ok) g_failed = 1;
+}
+
+static void test_mul(void)
+{
+	float err = 0.0f;
+	int i;
+	for(i = 0; i < RUNS; i++)
+	{
+		mat4_t a = rnd_mat4(), b = rnd_mat4();
+		float e = mat4_diff(mat4_mul(a, b), mat4_mul_scalar(a, b));
+		if(e > err) err = e;
+	}
+	report("mul", err, TOLERANCE);
+}
+
+static void test_mul_vec4(void)
+{
+	float err = 0.0f;
+	int i, j;
+	for(i = 0; i < RUNS; i++)
+	{
+		mat4_t M = rnd_mat4();
+		vec4_t v = vec4(rnd(), rnd(), rnd(), rnd());
+		vec4_t a = mat4_mul_vec4(M, v), b = mat4_mul_vec4_scalar(M, v);
+		for(j = 0; j < 4; j++)
+		{
+			float e = fabsf(a._[j] - b._[j]);
+			if(e > err) err = e;
+		}
+	}
+	report("mul_vec4", err, TOLERANCE);
+}
+
+static void test_invert(void)
+{
+	float err = 0.0f;
+	int i;
+	for(i = 0; i < RUNS; i++)
+	{
+		mat4_t M = rnd_mat4();
+		/* skip badly conditioned matrices, both sides are noise there */
+		if(mat4_diff(mat4_mul_scalar(M, mat4_invert_scalar(M)),
+					mat4()) > 1e-4f) continue;
+
+		/* the elimination order differs, so compare how well each one
+		 * inverts rather than the elements */
+		float e = mat4_diff(mat4_mul_scalar(M, mat4_invert(M)), mat4());
+		if(e > err) err = e;
+	}
+	report("invert", err, 1e-3f);
+}
+
+static void test_from_quat(void)
+{
+	float err = 0.0f;
+	int i;
+	for(i = 0; i < RUNS; i++)
+	{
+		/* not normalized, the expansion must match for any quaternion */
+		vec4_t q = vec4(rnd(), rnd(), rnd(), rnd());
+		float e = mat4_diff(mat4_from_quat(q), mat4_from_quat_scalar(q));
+		if(e > err) err = e;
+	}
+	report("from_quat", err, TOLERANCE * 4.0f);
+}
+
+static void test_batch(void)
+{
+	vec3_t in[37], out[38], ref;
+	n_t x[37], y[37], z[37], ox[37], oy[37], oz[37];
+	float err = 0.0f;
+	int i, j, k;
+	for(i = 0; i < RUNS / 100; i++)
+	{
+		mat4_t M = rnd_mat4();
+		int n = rand() % 37;
+		n_t w = (i & 1) ? 1.0f : 0.0f;
+		for(j = 0; j < n; j++)
+		{
+			in[j] = vec3(rnd(), rnd(), rnd());
+			x[j] = in[j].x; y[j] = in[j].y; z[j] = in[j].z;
+		}
+		out[n].x = 1234.0f;
+		if(w) mat4_mul_points(M, out, in, n);
+		else mat4_mul_dirs(M, out, in, n);
+		mat4_mul_vec3_soa(M, ox, oy, oz, x, y, z, n, w);
+		/* nothing written past the end */
+		if(out[n].x != 1234.0f) err = INFINITY;
+
+		for(j = 0; j < n; j++)
+		{
+			ref = mat4_mul_vec4_scalar(M, vec4(in[j].x, in[j].y, in[j].z, w)).xyz;
+			for(k = 0; k < 3; k++)
+			{
+				float e = fabsf(out[j]._[k] - ref._[k]);
+				if(e > err) err = e;
+			}
+			float e = fabsf(ox[j] - ref.x) + fabsf(oy[j] - ref.y) +
+				fabsf(oz[j] - ref.z);
+			if(e > err) err = e;
+		}
+	}
+	report("batch", err, TOLERANCE);
+}
+
+int main(void)
+{
+#if defined(MAFS_AVX)
+	printf("mafs: AVX\n");
+#elif defined(MAFS_SSE)
+	printf("mafs: SSE2\n");
+#elif defined(MAFS_NEON)
+	printf("mafs: NEON\n");
+#else
+	printf("mafs: scalar\n");
+#endif
+	srand(1);
+	test_mul();
+	test_mul_vec4();
+	test_invert();
+	test_from_quat();
+	test_batch();
+	return g_failed;
+}
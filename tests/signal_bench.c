@@ -0,0 +1,99 @@
+/* Times entity_signal on one entity while the number of entities grows.
+ * Entities are spread over TYPES component types, each listening with
+ * ENTITY, so the cost per signal should not depend on the entity count. */
+#include <ecm.h>
+#include <entity.h>
+#include <stdlib.h>
+
+#define TYPES 8
+#define SIGNALS 100000
+#define MAX_ENTITIES 100000
+
+typedef struct
+{
+	c_t super;
+	uint hits;
+} c_bench_t;
+
+static uint g_cts[TYPES];
+static const char *g_names[TYPES] = {
+	"bench0", "bench1", "bench2", "bench3",
+	"bench4", "bench5", "bench6", "bench7"
+};
+static DEC_SIG(bench_signal);
+static entity_t g_entities[MAX_ENTITIES];
+
+static int c_bench_on_signal(c_bench_t *self, void *data)
+{
+	self->hits++;
+	return 1;
+}
+
+static void add(uint count)
+{
+	static uint size = 0;
+	for(; size < count; size++)
+	{
+		_entity_new_pre();
+		component_new(g_cts[size % TYPES]);
+		g_entities[size] = _entity_new(0);
+	}
+}
+
+int main(void)
+{
+	uint sizes[] = {1000, 10000, MAX_ENTITIES};
+	uint s, i;
+
+	ecm_init();
+	signal_init(&bench_signal, 0);
+	for(i = 0; i < TYPES; i++)
+	{
+		g_cts[i] = IDENT_NULL;
+		ct_t *ct = ct_new(g_names[i], &g_cts[i], sizeof(c_bench_t), NULL, 0);
+		ct_listener(ct, ENTITY, bench_signal, c_bench_on_signal);
+	}
+	ecm_generate_dispatch();
+
+	printf("%d types, %d signals per size\n", TYPES, SIGNALS);
+	for(s = 0; s < sizeof(sizes) / sizeof(*sizes); s++)
+	{
+		add(sizes[s]);
+
+		ulong seed = 1;
+		Uint64 start = SDL_GetPerformanceCounter();
+		for(i = 0; i < SIGNALS; i++)
+		{
+			seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+			entity_signal(g_entities[(seed >> 33) % sizes[s]], bench_signal,
+					NULL);
+		}
+		Uint64 end = SDL_GetPerformanceCounter();
+
+		double ns = (double)(end - start) * 1e9 /
+			SDL_GetPerformanceFrequency() / SIGNALS;
+		printf("%7u entities: %8.1f ns per signal\n", sizes[s], ns);
+	}
+
+	uint hits = 0;
+	for(i = 0; i < TYPES; i++)
+	{
+		ct_t *ct = ecm_get(g_cts[i]);
+		uint p, j;
+		for(p = 0; p < ct->pages_size; p++)
+		{
+			for(j = 0; j < ct->pages[p].components_size; j++)
+			{
+				hits += ((c_bench_t*)ct_get_at(ct, p, j))->hits;
+			}
+		}
+	}
+	/* every signal reaches exactly the one component of its entity */
+	if(hits != SIGNALS * (sizeof(sizes) / sizeof(*sizes)))
+	{
+		printf("signal_bench: %u hits, expected %lu\n", hits,
+				(ulong)SIGNALS * (sizeof(sizes) / sizeof(*sizes)));
+		return 1;
+	}
+	return 0;
+}
@@ -17,7 +17,7 @@ CFLAGS = -DGLEW_STATIC $(shell sdl2-config --cflags) -DUSE_VAO -Wall -I. \
 
 CFLAGS_REL = $(CFLAGS) -O3
 
-CFLAGS_DEB = $(CFLAGS) -g3
+CFLAGS_DEB = $(CFLAGS) -g3 -DDEBUG
 
 ##############################################################################
 